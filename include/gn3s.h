@@ -38,6 +38,15 @@
 #include <string.h>
 #include <math.h>
 #include <libusb.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "gn3s_ring.h"
+#include "gn3s_ihex.h"
 /*--------------------------------------------------------------*/
 
 
@@ -62,6 +71,9 @@ struct fx2Config
 #define VRQ_GET_STATUS	(0x80)
 #define GS_RX_OVERRUN	(1)  //!< Returns 1 byte
 #define VRQ_XFER		(0x01)
+#define VRQ_RAM			(0xA3)	//!< Read or write FX2 xdata RAM
+#define USRP_HASH_SLOT_0_ADDR	(0xE1E0)	//!< Hash of the loaded firmware
+#define USRP_HASH_SLOT_1_ADDR	(0xE1F0)
 /*--------------------------------------------------------------*/
 
 
@@ -72,17 +84,19 @@ struct fx2Config
 #define VID_OLD  	 		(0x1781)
 #define PID_OLD  	 		(0x0B39)
 #define PROG_SET_CMD 		(0xE600)
-#define USB_BUFFER_SIZE     (16384)           //!< 8 MB
-#define USB_BLOCK_SIZE      (512)             //!< 16KB is hard limit
+#define FX2_UPLOAD_CHUNK    (1023)            //!< Largest 0xA0 firmware load request
+#define USB_BUFFER_SIZE     (16384)           //!< Default bytes per bulk transfer
+#define USB_BLOCK_SIZE      (512)             //!< Transfer sizes are a multiple of this
 #define USB_NBLOCKS         (USB_BUFFER_SIZE / USB_BLOCK_SIZE)
-#define USB_NTRANSFERS      (16)
+#define USB_NTRANSFERS      (16)              //!< Default bulk transfers in flight
+#define USB_RING_FACTOR     (4)               //!< Ring slots per transfer in flight
 #define USB_TIMEOUT         (1000)
-/*--------------------------------------------------------------*/
-
-
-/* The firmware is embedded into the executable */
-/*--------------------------------------------------------------*/
-extern char _binary_usrp_gn3s_firmware_ihx_start[];
+#define USB_EVENT_TIMEOUT   (100)             //!< Event loop wakeup period [ms]
+#define USB_STATUS_PERIOD   (100)             //!< Default overrun polling period [ms]
+#define USB_READ_TIMEOUT    (100)             //!< Longest a read blocks for samples [ms]
+#define USB_RENUM_TIMEOUT   (5000)            //!< Default wait for a flashed board [ms]
+#define USB_RENUM_POLL      (10)              //!< Device list polling period while waiting [ms]
+#define USB_XFER_RETRIES    (8)               //!< Failed transfers in a row before reopening the board
 /*--------------------------------------------------------------*/
 
 
@@ -95,44 +109,168 @@ class gn3s
 
 	private:
 
-		/* First or second board */
-		int which;
+		/* Which board: "" (first), an index, a bus-port path or a serial number */
+		std::string device;
+		std::string flashed_path;	//!< Where the board we flashed will reappear
+		uint8_t flashed_address;	//!< Its bus address before it renumerated
+		int renum_timeout;			//!< How long to wait for it [ms]
+		std::string device_path;	//!< USB port of the board we stream from
+
+		/* Recovery from the board being unplugged */
+		std::atomic<bool> xfer_running;		//!< Streaming was requested with VRQ_XFER
+		std::atomic<bool> device_lost;
+		std::atomic<bool> device_arrived;
+		std::atomic<unsigned long long> reconnect_count;
+		std::mutex hotplug_lock;
+		std::condition_variable hotplug_cond;
+		libusb_hotplug_callback_handle hotplug_handle;
+		bool hotplug_registered;
+
+		/* libusb state, one context per board */
+		libusb_context *ctx;
 
 		/* GN3S FX2 Stuff */
 		struct fx2Config fx2_config;
         struct libusb_device *fx2_device;
         struct libusb_device_handle *fx2_handle;
-        struct libusb_transfer *transfer[USB_NTRANSFERS];
+        int ntransfers;                     //!< Bulk transfers in flight
+        int transfer_size;                  //!< Bytes per bulk transfer
+        std::vector<struct libusb_transfer *> transfer;
+        std::atomic<int> active_transfers;  //!< Transfers still owned by libusb
+        std::atomic<bool> streaming;        //!< Resubmit completed transfers
+
+		/* Sample ring shared with read(), and where to put what does not fit */
+		gn3s_ring *ring;
+		unsigned char *discard;
+		unsigned long long host_overrun_base;	//!< Overruns of rings already released
+		unsigned long long lost_base;			//!< Bytes lost by rings already released
+		unsigned long long ungapped_base;		//!< Ungapped overruns of rings already released
+		std::atomic<unsigned long long> transfer_error_count;	//!< Transfers that failed
+		int transfer_error_run;		//!< Failed in a row, event thread only
+		bool use_dev_mem;			//!< Try kernel mapped transfer buffers
+		unsigned char *dev_mem;		//!< Ring and discard buffer, if kernel mapped
+		size_t dev_mem_size;
+
+		/* Wakes a reader blocked in wait() */
+		std::mutex data_lock;
+		std::condition_variable data_cond;
+		std::atomic<int> data_waiters;				//!< Readers blocked in wait()
+		std::atomic<unsigned long long> data_wanted;	//!< Bytes they wait for
+
+		/* Pollable descriptor for readers with their own event loop */
+		std::atomic<int> data_fd;					//!< eventfd, -1 until asked for
+		std::atomic<bool> data_fd_armed;			//!< Not signalled since last cleared
+		std::atomic<unsigned long long> data_fd_threshold;	//!< Bytes that make it readable
+
+		/* USB event handling thread */
+		std::thread event_thread;
+		std::atomic<bool> event_thread_run;
+		int event_priority;		//!< SCHED_FIFO priority, 0 = inherit
+
+		/* Overrun status polled asynchronously by the event thread */
+		struct libusb_transfer *status_xfer;
+		unsigned char status_buf[LIBUSB_CONTROL_SETUP_SIZE + 1];
+		std::atomic<bool> status_busy;			//!< status_xfer owned by libusb
+		std::mutex status_lock;					//!< Orders polls against stopping the stream
+		std::atomic<int> status_period;			//!< Polling period [ms], 0 = off
+		std::atomic<bool> rx_overrun_flag;		//!< Last reported FX2 overrun state
+		std::atomic<unsigned long long> rx_overrun_count;	//!< Polls that saw an overrun
+
+		/* What the FX2 lost in an overrun, from how far the stream lags the host clock */
+		std::atomic<bool> lag_restart;			//!< Streaming (re)started, take a new reference
+		bool lag_valid;
+		std::chrono::steady_clock::time_point lag_time;	//!< Reference point
+		unsigned long long lag_bytes;			//!< Bytes in or lost at that point
+		double lag_normal;						//!< Lag at the last poll without overrun [bytes]
+		bool usb_fx2_estimate_loss(bool overrun);
 
 		/* USB IDs */
 		unsigned int gn3s_vid, gn3s_pid;
 
-		/* Pull in the binary firmware */
-		int fstart;
-		int fsize;
-		//char *gn3s_firmware;
+		/* Intel HEX file to flash instead of the built-in firmware, if not empty */
+		std::string firmware;
 
 	public:
 
-		gn3s(int _which);		//!< Constructor
+		gn3s(const std::string &_device, int _ntransfers = USB_NTRANSFERS,
+				int _transfer_size = USB_BUFFER_SIZE, bool _dev_mem = true,
+				int _event_priority = 0, const std::string &_firmware = "",
+				int _renum_timeout = USB_RENUM_TIMEOUT);	//!< Constructor
 		~gn3s();				//!< Destructor
 
 		/* FX2 functions */
-        struct libusb_device* usb_fx2_find(unsigned int vid, unsigned int pid, char info, int ignore);
+        struct libusb_device* usb_fx2_find(unsigned int vid, unsigned int pid, const std::string &spec);
+        static std::string usb_fx2_path(struct libusb_device *dev);
         bool usb_fx2_configure(struct libusb_device *fx2, fx2Config *fx2c);
+        bool usb_fx2_open(const std::string &spec);
+        struct libusb_device* usb_fx2_wait(unsigned int vid, unsigned int pid,
+                const std::string &path, int timeout);
+        void usb_fx2_close();
+        void usb_fx2_hotplug(struct libusb_device *dev, int event);
+        bool usb_fx2_recover();
+        void usb_fx2_alloc_buffers();
+        void usb_fx2_release_buffers();
         bool usb_fx2_start_transfers();
         bool usb_fx2_cancel_transfers();
-        int read(unsigned char *buff, int bytes);
+        void usb_fx2_free_transfers();
+        void usb_fx2_transfer_done(struct libusb_transfer *xfer);
+        void usb_fx2_poll_status();
+        void usb_fx2_status_done(struct libusb_transfer *xfer);
+        bool usb_event_thread_start();
+        void usb_event_thread_stop();
+        void usb_event_loop();
+        void usb_fx2_wake(bool always);
+        bool wait(unsigned long long bytes, int timeout);
+        void signal_data_fd();
+        int get_data_fd(unsigned long long threshold);
+        void clear_data_fd();
+        int read(unsigned char *buff, int bytes, int min_bytes = 0, int timeout = 0);
+        //! Lend the next contiguous bytes, valid until the next acquire() or read()
+        int acquire(const unsigned char **span)
+        {
+            int n = (ring != nullptr) ? ring->peek(span) : 0;
+            if ((n == 0) && device_lost && usb_fx2_recover())
+                n = ring->peek(span);
+            return n;
+        }
+        void release(int bytes) { ring->consume(bytes); }                      //!< Give back lent bytes
+        unsigned long long gap() { return (ring != nullptr) ? ring->gap() : 0; }   //!< Bytes missing before the next acquire()
+        void take_gap() { if (ring != nullptr) ring->take_gap(); }             //!< The gap was accounted for
+        unsigned long long available() { return (ring != nullptr) ? ring->fill() : 0; }
+        unsigned long long capacity()                                         //!< Bytes the ring holds
+        {
+            return (ring != nullptr) ? (unsigned long long)ring->size() * ring->get_slot_size() : 0;
+        }
+        unsigned long long lost_bytes()                                       //!< Dropped or lost by the FX2
+        {
+            return lost_base + ((ring != nullptr) ? ring->get_lost_bytes() : 0);
+        }
+        unsigned long long transfer_errors() { return transfer_error_count; }
+        int get_transfer_size() { return transfer_size; }
+        unsigned long long reconnects() { return reconnect_count; }            //!< Times the board came back
+        unsigned long long host_overruns()
+        {
+            return host_overrun_base + ((ring != nullptr) ? ring->get_overruns() : 0);
+        }
 		int write_cmd(int request, int value, int index, unsigned char *bytes, int len);
 		bool _get_status(int which, bool *trouble);
 		bool check_rx_overrun();
+		void set_overrun_poll(int ms) { status_period = ms; }		//!< 0 disables polling
+		bool rx_overrun() { return rx_overrun_flag; }				//!< Latest polled state
+		unsigned long long rx_overruns() { return rx_overrun_count; }	//!< Polls that saw an overrun
+		unsigned long long rx_overruns_ungapped()		//!< Of those, ones that left no gap to tag
+		{
+			return ungapped_base + ((ring != nullptr) ? ring->get_ungapped_overruns() : 0);
+		}
 		bool usrp_xfer(char VRQ_TYPE, bool start);
 
 		/* Used to flash the GN3S */
-		int atoz(char *s);
-        void upload_ram(unsigned char *buf, int start, int len);
-		void program_fx2(char *filename, char mem);
-		int prog_gn3s_board();
+		bool load_firmware(gn3s_fw_image &image);
+		bool firmware_matches(const unsigned char *hash);
+        bool upload_ram(const unsigned char *buf, int start, int len);
+		bool program_fx2(const gn3s_fw_image &image);
+		int prog_gn3s_board(unsigned int vid, unsigned int pid, const std::string &spec,
+				const gn3s_fw_image &image, const unsigned char *hash);
 
 };
 /*--------------------------------------------------------------*/
@@ -0,0 +1,78 @@
+/*!
+ * \file gn3s_ihex.h
+ * \brief Intel HEX firmware images for the GN3S FX2 microcontroller.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef GN3S_IHEX_H_
+#define GN3S_IHEX_H_
+
+#include <string>
+#include <vector>
+
+/*! \ingroup STRUCTS
+ *  @brief Contiguous block of firmware bytes loaded at \a addr */
+struct gn3s_fw_segment
+{
+	unsigned int addr;
+	std::vector<unsigned char> data;
+};
+
+typedef std::vector<gn3s_fw_segment> gn3s_fw_image;
+
+#define GN3S_FW_HASH_SIZE   (16)    //!< Bytes in a firmware hash slot
+
+/*! \ingroup STRUCTS
+ *  @brief Segment of the firmware compiled into the library */
+struct gn3s_fw_builtin_segment
+{
+	unsigned int addr;
+	unsigned int len;
+	const unsigned char *data;
+};
+
+/* Generated from lib/gn3s_firmware.ihx by gn3s_fw2cc at build time */
+extern const gn3s_fw_builtin_segment gn3s_firmware_segments[];
+extern const int gn3s_firmware_nsegments;
+
+/*!
+ * Parse Intel HEX \a text into \a image: records are checksummed, must
+ * fit the 16-bit FX2 address space, must not overlap and must end with
+ * an end-of-file record. Adjacent records are merged into one segment,
+ * and segments come out sorted by address. On failure \a error says why.
+ */
+bool gn3s_ihex_parse(const std::string &text, gn3s_fw_image &image, std::string &error);
+
+//! Read and parse the Intel HEX file \a filename
+bool gn3s_ihex_load(const char *filename, gn3s_fw_image &image, std::string &error);
+
+/*!
+ * Fingerprint of \a image, addresses included, stored in one of the
+ * firmware's hash slots so the host can tell what the board is running.
+ */
+void gn3s_fw_hash(const gn3s_fw_image &image, unsigned char hash[GN3S_FW_HASH_SIZE]);
+
+#endif /* GN3S_IHEX_H_ */
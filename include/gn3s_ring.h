@@ -0,0 +1,336 @@
+/*!
+ * \file gn3s_ring.h
+ * \brief Lock-free single producer / single consumer ring of USB transfer slots.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef GN3S_RING_H_
+#define GN3S_RING_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#define GN3S_CACHE_LINE     (64)
+
+/*--------------------------------------------------------------*/
+/*! \ingroup CLASSES
+ *
+ * The ring is made of \a nslots slots of \a slot_size bytes, one bulk
+ * transfer each. The producer (the USB event thread) claims the next free
+ * slot when it (re)submits a transfer and commits it with the number of
+ * bytes actually received when the transfer completes. Slots are
+ * published to the consumer strictly in claim order, even if a slot is
+ * committed empty or short. When the consumer falls behind there is no
+ * slot to claim; the transfer is then pointed at a scratch buffer and its
+ * payload is accounted as a host overrun through drop().
+ *
+ * The consumer reads through peek()/consume(), which hand out runs of
+ * contiguous bytes directly from the slot memory.
+ *
+ * Bytes that never made it into the ring, dropped ones as well as those
+ * the device is estimated to have lost, are recorded against the next
+ * non-empty slot published. Transfers complete in the order they were
+ * submitted, so dropped bytes sit exactly where they were missing from
+ * the stream. Estimated losses are only known when the device is next
+ * polled, so they are placed to within one status-poll period. A device
+ * overrun whose loss could not be estimated is only counted, see overrun().
+ * A run from peek() never spans such a gap; gap() tells the consumer
+ * about it before the first byte after it.
+ *
+ * All counters are 64-bit and only ever grow, so index arithmetic never
+ * wraps in practice.
+ */
+class gn3s_ring
+{
+
+	private:
+
+		int nslots;					//!< Number of transfer slots
+		int slot_size;				//!< Bytes per slot
+		unsigned char *storage;		//!< nslots * slot_size bytes
+		bool own_storage;			//!< storage allocated by the ring
+		std::vector<int> lens;		//!< Bytes received in each published slot
+		std::vector<uint64_t> lost;	//!< Bytes missing just before each published slot
+
+		/* Producer private state */
+		std::vector<char> ready;	//!< Slot committed but not yet published
+		uint64_t claimed;			//!< Slots handed out to transfers
+		uint64_t published;			//!< Local copy of head
+		uint64_t received;			//!< Local copy of bytes_in
+		uint64_t pending_lost;		//!< Missing bytes waiting for a slot to go before
+		char pad0[GN3S_CACHE_LINE];
+
+		/* Written by the producer */
+		std::atomic<uint64_t> head;			//!< Slots published
+		std::atomic<uint64_t> bytes_in;		//!< Bytes published
+		std::atomic<uint64_t> overrun_count;	//!< Transfers dropped, ring full
+		std::atomic<uint64_t> overrun_bytes;	//!< Bytes dropped, ring full
+		std::atomic<uint64_t> lost_bytes;		//!< Bytes dropped or lost by the device
+		std::atomic<uint64_t> ungapped_count;	//!< Device overruns with no gap to show them
+		char pad1[GN3S_CACHE_LINE];
+
+		/* Written by the consumer */
+		std::atomic<uint64_t> tail;			//!< Slots released
+		std::atomic<uint64_t> bytes_out;	//!< Bytes consumed
+		int offset;							//!< Read offset within slot tail
+		char pad2[GN3S_CACHE_LINE];
+
+	public:
+
+		//! Use \a _storage of nslots * slot_size bytes if given, else allocate it
+		gn3s_ring(int _nslots, int _slot_size, unsigned char *_storage = nullptr)
+			: nslots(_nslots), slot_size(_slot_size),
+			  lens(_nslots, 0), lost(_nslots, 0), ready(_nslots, 0)
+		{
+			own_storage = (_storage == nullptr);
+			storage = own_storage ? new unsigned char[(size_t)nslots * slot_size] : _storage;
+			reset();
+		}
+
+		~gn3s_ring()
+		{
+			if (own_storage)
+				delete[] storage;
+		}
+
+		//! Forget all data. Only call when neither side is active.
+		void reset()
+		{
+			for (int i = 0; i < nslots; i++)
+			{
+				lens[i] = 0;
+				lost[i] = 0;
+				ready[i] = 0;
+			}
+			claimed = published = received = pending_lost = 0;
+			head = 0;
+			bytes_in = 0;
+			overrun_count = 0;
+			overrun_bytes = 0;
+			lost_bytes = 0;
+			ungapped_count = 0;
+			tail = 0;
+			bytes_out = 0;
+			offset = 0;
+		}
+
+		int size() const { return nslots; }
+		int get_slot_size() const { return slot_size; }
+
+		/*----------------------------------------------------------*/
+		/* Producer side                                            */
+		/*----------------------------------------------------------*/
+
+		//! Claim the next slot for a transfer, -1 if the consumer is a full ring behind
+		int claim()
+		{
+			if (claimed - tail.load(std::memory_order_acquire) >= (uint64_t)nslots)
+				return -1;
+			return (int)(claimed++ % nslots);
+		}
+
+		unsigned char *slot(int idx) const
+		{
+			return storage + (size_t)idx * slot_size;
+		}
+
+		//! Slot index owning \a ptr, -1 if \a ptr is not ring memory
+		int slot_of(const unsigned char *ptr) const
+		{
+			if ((ptr < storage) || (ptr >= storage + (size_t)nslots * slot_size))
+				return -1;
+			return (int)((ptr - storage) / slot_size);
+		}
+
+		//! Complete a claimed slot with \a len valid bytes (possibly zero)
+		void commit(int idx, int len)
+		{
+			int s;
+
+			lens[idx] = len;
+			ready[idx] = 1;
+
+			/* Publish every consecutive slot that is complete */
+			while (published < claimed)
+			{
+				s = (int)(published % nslots);
+				if (!ready[s])
+					break;
+				ready[s] = 0;
+				lost[s] = 0;
+				if (lens[s] > 0)
+				{
+					lost[s] = pending_lost;
+					pending_lost = 0;
+				}
+				received += lens[s];
+				published++;
+			}
+
+			/* head first, so anybody seeing bytes_in also sees the slots */
+			head.store(published, std::memory_order_release);
+			bytes_in.store(received, std::memory_order_release);
+		}
+
+		//! Account for a transfer that had no slot to land in
+		void drop(int len)
+		{
+			if (len <= 0)
+				return;
+			overrun_count.store(overrun_count.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed);
+			overrun_bytes.store(overrun_bytes.load(std::memory_order_relaxed) + len,
+					std::memory_order_relaxed);
+			skip(len);
+		}
+
+		//! Account for \a len bytes missing from the stream ahead of the next slot
+		void skip(uint64_t len)
+		{
+			pending_lost += len;
+			lost_bytes.store(lost_bytes.load(std::memory_order_relaxed) + len,
+					std::memory_order_relaxed);
+		}
+
+		/*!
+		 * Account for a device overrun that lost an estimated \a len bytes,
+		 * 0 if unknown. Returns true if it shows as a gap; if not, it is
+		 * only counted, so the consumer can still tell it happened.
+		 */
+		bool overrun(uint64_t len)
+		{
+			if (len > 0)
+			{
+				skip(len);
+				return true;
+			}
+			ungapped_count.store(ungapped_count.load(std::memory_order_relaxed) + 1,
+					std::memory_order_release);
+			return false;
+		}
+
+		/*----------------------------------------------------------*/
+		/* Consumer side                                            */
+		/*----------------------------------------------------------*/
+
+		//! Contiguous readable bytes starting at *ptr, 0 if the ring is empty
+		int peek(const unsigned char **ptr)
+		{
+			uint64_t h = head.load(std::memory_order_acquire);
+			uint64_t t = tail.load(std::memory_order_relaxed);
+			int s, n;
+
+			/* Release empty or exhausted slots */
+			while ((t < h) && (offset >= lens[t % nslots]))
+			{
+				offset = 0;
+				t++;
+				tail.store(t, std::memory_order_release);
+			}
+			if (t == h)
+				return 0;
+
+			s = (int)(t % nslots);
+			*ptr = slot(s) + offset;
+			n = lens[s] - offset;
+
+			/* Full slots are followed by their successor in memory, unless bytes are missing in between */
+			while ((lens[s] == slot_size) && (t + 1 < h) && (s + 1 < nslots) && (lost[s + 1] == 0))
+			{
+				t++;
+				s++;
+				n += lens[s];
+			}
+			return n;
+		}
+
+		//! Mark \a n bytes returned by peek() as read
+		void consume(int n)
+		{
+			uint64_t h = head.load(std::memory_order_acquire);
+			uint64_t t = tail.load(std::memory_order_relaxed);
+
+			bytes_out.store(bytes_out.load(std::memory_order_relaxed) + n,
+					std::memory_order_release);
+			offset += n;
+			while ((t < h) && (offset >= lens[t % nslots]))
+			{
+				offset -= lens[t % nslots];
+				t++;
+			}
+			tail.store(t, std::memory_order_release);
+		}
+
+		//! Bytes missing just before the next byte peek() returns, until take_gap()
+		uint64_t gap()
+		{
+			uint64_t h = head.load(std::memory_order_acquire);
+			uint64_t t = tail.load(std::memory_order_relaxed);
+
+			/* Step over exhausted and empty slots, as peek() does */
+			while ((t < h) && (offset >= lens[t % nslots]))
+			{
+				offset = 0;
+				t++;
+				tail.store(t, std::memory_order_release);
+			}
+			if ((t == h) || (offset != 0))
+				return 0;
+			return lost[t % nslots];
+		}
+
+		//! The gap reported by gap() has been dealt with
+		void take_gap()
+		{
+			uint64_t h = head.load(std::memory_order_acquire);
+			uint64_t t = tail.load(std::memory_order_relaxed);
+
+			if ((t < h) && (offset == 0))
+				lost[t % nslots] = 0;
+		}
+
+		/*----------------------------------------------------------*/
+		/* Either side                                              */
+		/*----------------------------------------------------------*/
+
+		//! Bytes waiting to be consumed
+		uint64_t fill() const
+		{
+			return bytes_in.load(std::memory_order_acquire) -
+				bytes_out.load(std::memory_order_acquire);
+		}
+
+		uint64_t get_bytes_in() const { return bytes_in.load(std::memory_order_acquire); }
+		uint64_t get_overruns() const { return overrun_count.load(std::memory_order_relaxed); }
+		uint64_t get_overrun_bytes() const { return overrun_bytes.load(std::memory_order_relaxed); }
+		uint64_t get_lost_bytes() const { return lost_bytes.load(std::memory_order_relaxed); }
+		uint64_t get_ungapped_overruns() const { return ungapped_count.load(std::memory_order_acquire); }
+
+};
+/*--------------------------------------------------------------*/
+
+#endif /* GN3S_RING_H_ */
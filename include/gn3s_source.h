@@ -28,6 +28,24 @@
 
 #include "gn3s_defines.h"
 #include "gn3s.h"
+#include "gn3s_unpack.h"
+
+#define GN3S_TIMELINE_START		(0x1)	//!< Streaming (re)started before this sample
+#define GN3S_TIMELINE_OVERFLOW	(0x2)	//!< Samples were lost before this one
+
+/*! \ingroup STRUCTS
+ *  @brief What a gn3s_Source has seen so far */
+typedef struct gn3s_stats
+{
+	unsigned long long samples;			//!< I/Q pairs read
+	unsigned long long transfer_errors;	//!< USB transfers that failed
+	unsigned long long rx_overruns;		//!< FX2 FIFO overruns
+	unsigned long long host_overruns;	//!< Transfers dropped, ring full
+	unsigned long long lost_samples;	//!< I/Q pairs dropped or lost in the FX2
+	unsigned long long reconnects;		//!< Times the board came back
+	unsigned long long slips;			//!< I/Q phase slips
+	double ring_fill;					//!< Part of the ring waiting to be read, 0 to 1
+} gn3s_stats;
 
 /*! \ingroup CLASSES
  *
@@ -43,6 +61,15 @@ class gn3s_Source
 		int leftover;			//!< Leftover bytes for USRP double buffering
 		int bwrite;			//!< Bytes somthing something?
 		int ms_count;			//!< Count the numbers of ms processed
+		std::string device;		//!< Which board, see gn3s::usb_fx2_find()
+		int ntransfers;			//!< USB bulk transfers in flight
+		int transfer_size;		//!< Bytes per USB bulk transfer
+		bool dev_mem;			//!< Kernel mapped USB transfer buffers
+		std::string firmware;	//!< Intel HEX file overriding the built-in firmware
+		int renum_timeout;		//!< Wait for the board to come back after flashing [ms]
+		bool fill_gaps;			//!< Write zeros for lost samples rather than just report them
+		int event_priority;		//!< SCHED_FIFO priority of the USB event thread, 0 = inherit
+		int status_period;		//!< FX2 overrun polling period [ms], 0 = off
 
 		bool flag_first_read;
 		/* Tag overflows */
@@ -52,11 +79,24 @@ class gn3s_Source
 		/* AGC Values */
 		int agc_scale;		//!< To do the AGC
 		int overflw;			//!< Overflow counter
-		int soverflw;			//!< Overflow counter
+		unsigned long long host_overruns;	//!< Ring overruns already reported
+		unsigned long long rx_overruns;		//!< FX2 overruns already reported
+		unsigned long long rx_ungapped;		//!< FX2 overruns already tagged without a gap
+		unsigned long long reconnects;		//!< Device reconnections already reported
+		unsigned long long slips;			//!< I/Q phase slips already reported
+
+		/* Where the stream was interrupted, for the blocks to tag */
+		unsigned long long sample_count;	//!< I/Q pairs handed out so far
+		int timeline_pending;				//!< GN3S_TIMELINE_* not yet attached to a sample
+		int timeline;						//!< GN3S_TIMELINE_* of the first sample of the last Read
+		unsigned long long timeline_sample;	//!< That sample
+		double timeline_time;				//!< Its estimated host time [s since the epoch]
+		unsigned long long timeline_lost;	//!< I/Q pairs known to be lost just before it
+		unsigned long long lost_pending;	//!< I/Q pairs lost, not yet attached to a sample
+		unsigned long long gap_left;		//!< Zeros still to write for a gap
 
-		/* Data buffers */
-        unsigned char gbuff[GN3S_SAMPS_5MS*2]; 	//!< Byte buffer for GN3S
-		GN3S_CPX buff[GN3S_SAMPS_5MS]; 		//!< Base buffer for GN3S
+		/* Unpacks the byte stream, keeping I/Q in step across reads */
+		gn3s_iq_tracker iq;
 
 		/* SOURCE_SIGE_GN3S Handles */
 		gn3s *gn3s_a;
@@ -65,13 +105,24 @@ class gn3s_Source
 
 		void Open_GN3S();			//!< Open the SparkFun GN3S Sampler
 		void Close_GN3S();			//!< Close the SparkFun GN3S Sampler
-		int Read_GN3S(gn3s_ms_packet *_p,int n_samples);	//!< Read from the SparkFun GN3S Sampler
+		int Read_GN3S(void *_p,int n_samples,gn3s_sample_format format);	//!< Read from the SparkFun GN3S Sampler
 
 	public:
 
-		gn3s_Source();	//!< Create the GPS source with the proper hardware type
+		gn3s_Source(const std::string &_device = "", int _ntransfers = USB_NTRANSFERS,
+				int _transfer_size = USB_BUFFER_SIZE, bool _dev_mem = true,
+				const std::string &_firmware = "", int _renum_timeout = USB_RENUM_TIMEOUT,
+				bool _fill_gaps = true, int _event_priority = 0,
+				int _status_period = USB_STATUS_PERIOD);	//!< Create the GPS source with the proper hardware type
 		~gn3s_Source();					//!< Kill the object
-		int Read(gn3s_ms_packet *_p,int n_samples);		//!< Read in a single ms of data
+		bool Start();					//!< Start streaming, dropping stale samples
+		bool Stop();					//!< Stop streaming
+		void Flush();					//!< Drop the samples buffered so far
+		void getStats(gn3s_stats *stats);	//!< Counters since the source was created
+		int Read(void *_p,int n_samples,gn3s_sample_format format = GN3S_FLOAT);	//!< Read up to n_samples interleaved I/Q pairs
+		unsigned long long getSampleCount(){return(sample_count);}	//!< I/Q pairs read so far
+		int getTransferSize(){return(gn3s_a->get_transfer_size());}	//!< Bytes per USB transfer, as rounded by the driver
+		int getTimeline(unsigned long long *sample, double *time, unsigned long long *lost);	//!< GN3S_TIMELINE_* of the last Read, and where
 		int getScale(){return(agc_scale);}
 		int getOvrflw(){return(overflw);}
 
@@ -0,0 +1,102 @@
+/*!
+ * \file gn3s_source_base.h
+ * \brief Common part of the GN3S source blocks, one per output item type.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2012  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#ifndef INCLUDED_GN3S_SOURCE_BASE_H
+#define INCLUDED_GN3S_SOURCE_BASE_H
+
+#include "gn3s_api.h"
+#include <gnuradio/sync_block.h>
+#include <chrono>
+#include <string>
+
+class gn3s_Source;
+
+/*!
+ * \brief SiGe GN3S V2 sampler USB driver, whatever the output type.
+ * \ingroup block
+ *
+ * Opens the board and unpacks its samples straight into the output
+ * buffer. The output buffer is sized in whole USB transfers, so each
+ * call to work() can take at least one transfer's worth of samples. The
+ * blocks deriving from it only choose the item type: gn3s_source_cc,
+ * gn3s_source_cs, gn3s_source_cb, gn3s_source_ibyte, gn3s_source_packed
+ * and gn3s_source_raw.
+ *
+ * The first item after a start, an overflow or a reconnection carries
+ * UHD style rx_time and rx_rate tags, plus rx_overflow if samples were
+ * lost. rx_time is the host clock estimate for that sample and rx_rate
+ * the output item rate, which differs from the I/Q pair rate for the
+ * ibyte, raw and packed blocks. Where the number of I/Q pairs lost is
+ * known, or estimated for FX2 overruns, an rx_gap tag gives it; with
+ * fill_gaps the tagged item is the first of the zeros standing in for
+ * them.
+ *
+ * The "command" message port takes a symbol, a (command . value) pair
+ * or a dictionary of them: start, stop, reset_fifo (drop what is
+ * buffered) and stats_interval (ms). The "stats" port publishes a
+ * dictionary of counters every stats_interval ms: samples, throughput
+ * (I/Q pairs per second), transfer_errors, rx_overruns, host_overruns,
+ * lost_samples, reconnects, slips and ring_fill (0 to 1).
+ */
+class GN3S_API gn3s_source_base : public gr::sync_block
+{
+protected:
+  gn3s_Source *gn3s_drv;	// driver for this board
+  int format;			// gn3s_sample_format written to the output
+  int items_per_sample;		// output items per I/Q pair
+  int samples_per_item;		// I/Q pairs per output item
+  bool paused;			// streaming stopped by a command
+  int stats_interval;		// ms between stats messages, 0 for none
+  std::chrono::steady_clock::time_point stats_time;	// when the last were sent
+  unsigned long long stats_samples;			// samples read by then
+
+  gn3s_source_base (const std::string &name, size_t itemsize, int format,
+                    int items_per_sample, int samples_per_item, const std::string &device,
+                    int num_transfers, int transfer_size, bool dev_mem,
+                    const std::string &firmware, int renum_timeout,
+                    bool fill_gaps, int event_priority, int status_period);
+
+  void handle_command (pmt::pmt_t msg);
+  void do_command (const std::string &cmd, pmt::pmt_t value);
+  void publish_stats ();
+
+ public:
+  ~gn3s_source_base ();
+
+  bool start ();
+  bool stop ();
+
+  //! Publish statistics every \a ms milliseconds, 0 to stop
+  void set_stats_interval (int ms);
+
+  int work (int noutput_items,
+	    gr_vector_const_void_star &input_items,
+	    gr_vector_void_star &output_items);
+};
+
+#endif /* INCLUDED_GN3S_SOURCE_BASE_H */
@@ -0,0 +1,106 @@
+/*!
+ * \file gn3s_source_cb.h
+ * \brief GNU Radio source block for the SiGe GN3S USB sampler v2, complex int8.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2012  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#ifndef INCLUDED_GN3S_SOURCE_CB_H
+#define INCLUDED_GN3S_SOURCE_CB_H
+
+#include "gn3s_api.h"
+#include "gn3s_source_base.h"
+#include <string>
+
+class gn3s_source_cb;
+
+/*
+ * We use boost::shared_ptr's instead of raw pointers for all access
+ * to gr_blocks (and many other data structures).  The shared_ptr gets
+ * us transparent reference counting, which greatly simplifies storage
+ * management issues.  This is especially helpful in our hybrid
+ * C++ / Python system.
+ *
+ * See http://www.boost.org/libs/smart_ptr/smart_ptr.htm
+ *
+ * As a convention, the _sptr suffix indicates a boost::shared_ptr
+ */
+typedef boost::shared_ptr<gn3s_source_cb> gn3s_source_cb_sptr;
+
+/*!
+ * \brief Make a GN3S source block with complex int8 output, see gn3s_source_cb.
+ *
+ * \param device which board to open: "" for the first one, an index,
+ *        a "bus-port[.port]" USB path or a serial number
+ * \param num_transfers USB bulk transfers kept in flight
+ * \param transfer_size bytes per USB bulk transfer, a multiple of 512
+ * \param dev_mem let the kernel map the transfer buffers (zero-copy usbfs)
+ *        when it supports it
+ * \param firmware Intel HEX file to flash instead of the firmware built
+ *        into the library, "" for the built-in one
+ * \param renum_timeout how long to wait for the board to come back after
+ *        flashing it, in ms
+ * \param fill_gaps write zeros in place of samples lost in an overrun, so
+ *        the output keeps in step with the sample clock; otherwise the gap
+ *        is only tagged.
+ * \param event_priority SCHED_FIFO priority of the USB event thread,
+ *        0 to inherit the scheduling of the calling thread
+ * \param status_period how often the FX2 overrun status is polled, in ms,
+ *        0 to not poll it
+ */
+GN3S_API gn3s_source_cb_sptr gn3s_make_source_cb (const std::string &device = "",
+                                                  int num_transfers = 16, int transfer_size = 16384,
+                                                  bool dev_mem = true,
+                                                  const std::string &firmware = "",
+                                                  int renum_timeout = 5000,
+                                                  bool fill_gaps = true,
+                                                  int event_priority = 0,
+                                                  int status_period = 100);
+
+/*!
+ * \brief SiGe GN3S V2 sampler USB driver, complex int8 output: I and Q as two int8_t per item.
+ * \ingroup block
+ *
+ * Samples are +1 or -1, so nothing is lost against gn3s_source_cc.
+ */
+class GN3S_API gn3s_source_cb : public gn3s_source_base
+{
+private:
+  // The friend declaration allows gn3s_make_source_cb to
+  // access the private constructor.
+
+  friend GN3S_API gn3s_source_cb_sptr gn3s_make_source_cb (const std::string &device,
+                                                           int num_transfers, int transfer_size,
+                                                           bool dev_mem, const std::string &firmware,
+                                                           int renum_timeout, bool fill_gaps,
+                                                           int event_priority, int status_period);
+
+  gn3s_source_cb (const std::string &device, int num_transfers, int transfer_size,
+                  bool dev_mem, const std::string &firmware,
+                  int renum_timeout, bool fill_gaps,
+                  int event_priority, int status_period);  	// private constructor
+
+};
+
+#endif /* INCLUDED_GN3S_SOURCE_CB_H */
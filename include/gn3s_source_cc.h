@@ -31,7 +31,8 @@
 #define INCLUDED_GN3S_SOURCE_CC_H
 
 #include "gn3s_api.h"
-#include <gnuradio/block.h>
+#include "gn3s_source_base.h"
+#include <string>
 
 class gn3s_source_cc;
 
@@ -54,37 +55,62 @@ typedef boost::shared_ptr<gn3s_source_cc> gn3s_source_cc_sptr;
  * To avoid accidental use of raw pointers, gn3s_source's
  * constructor is private.  gn3s_source is the public
  * interface for creating new instances.
+ *
+ * \param device which board to open: "" for the first one, an index,
+ *        a "bus-port[.port]" USB path or a serial number
+ * \param num_transfers USB bulk transfers kept in flight
+ * \param transfer_size bytes per USB bulk transfer, a multiple of 512
+ * \param dev_mem let the kernel map the transfer buffers (zero-copy usbfs)
+ *        when it supports it
+ * \param firmware Intel HEX file to flash instead of the firmware built
+ *        into the library, "" for the built-in one
+ * \param renum_timeout how long to wait for the board to come back after
+ *        flashing it, in ms
+ * \param fill_gaps write zeros in place of samples lost in an overrun, so
+ *        the output keeps in step with the sample clock; otherwise the gap
+ *        is only tagged.
+ * \param event_priority SCHED_FIFO priority of the USB event thread,
+ *        0 to inherit the scheduling of the calling thread
+ * \param status_period how often the FX2 overrun status is polled, in ms,
+ *        0 to not poll it
  */
-GN3S_API gn3s_source_cc_sptr gn3s_make_source_cc ();
+GN3S_API gn3s_source_cc_sptr gn3s_make_source_cc (const std::string &device = "",
+                                                  int num_transfers = 16, int transfer_size = 16384,
+                                                  bool dev_mem = true,
+                                                  const std::string &firmware = "",
+                                                  int renum_timeout = 5000,
+                                                  bool fill_gaps = true,
+                                                  int event_priority = 0,
+                                                  int status_period = 100);
 
 /*!
- * \brief SiGe GN3S V2 sampler USB driver.
+ * \brief SiGe GN3S V2 sampler USB driver, gr_complex output.
  * \ingroup block
  *
- * \sa gn3s_source for a version that subclasses gr_block.
+ * \sa gn3s_source_cs, gn3s_source_cb, gn3s_source_ibyte and
+ * gn3s_source_packed for
+ * smaller integer outputs of the same samples.
  */
-class GN3S_API gn3s_source_cc : public gr::block
+class GN3S_API gn3s_source_cc : public gn3s_source_base
 {
 private:
   // The friend declaration allows gn3s_source to
   // access the private constructor.
 
-  friend GN3S_API gn3s_source_cc_sptr gn3s_make_source_cc ();
+  friend GN3S_API gn3s_source_cc_sptr gn3s_make_source_cc (const std::string &device,
+                                                           int num_transfers, int transfer_size,
+                                                           bool dev_mem, const std::string &firmware,
+                                                           int renum_timeout, bool fill_gaps,
+                                                           int event_priority, int status_period);
 
   /*!
    * \brief
    */
-  gn3s_source_cc ();  	// private constructor
-
- public:
-  ~gn3s_source_cc ();	// public destructor
-
-  // Where all the action really happens
+  gn3s_source_cc (const std::string &device, int num_transfers, int transfer_size,
+                  bool dev_mem, const std::string &firmware,
+                  int renum_timeout, bool fill_gaps,
+                  int event_priority, int status_period);  	// private constructor
 
-  int general_work (int noutput_items,
-		    gr_vector_int &ninput_items,
-		    gr_vector_const_void_star &input_items,
-		    gr_vector_void_star &output_items);
 };
 
 #endif /* INCLUDED_GN3S_SOURCE_CC_H */
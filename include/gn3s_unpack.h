@@ -0,0 +1,268 @@
+/*!
+ * \file gn3s_unpack.h
+ * \brief Kernels turning raw GN3S sample bytes into floating point, integer or packed I/Q.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef GN3S_UNPACK_H_
+#define GN3S_UNPACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define GN3S_I_MARKER       (0x2)     //!< Set in I bytes, clear in Q bytes
+#define GN3S_TRACK_BLOCK    (4096)    //!< Bytes checked and unpacked while in cache
+
+/*
+ * The GN3S sends one byte per I or Q sample, I first. Bit 0 is the sign
+ * of the sample, 0 for +1 and 1 for -1. A kernel turns \a nbytes such
+ * bytes into as many floats, so a whole number of I/Q pairs fills
+ * gr_complex values directly.
+ */
+typedef void (*gn3s_unpack_fn)(const unsigned char *in, float *out, int nbytes);
+
+//! The same into +1/-1 int16_t or int8_t, for complex int16, complex int8 and ibyte outputs
+typedef void (*gn3s_unpack16_fn)(const unsigned char *in, int16_t *out, int nbytes);
+typedef void (*gn3s_unpack8_fn)(const unsigned char *in, int8_t *out, int nbytes);
+
+/*
+ * Or packed four I/Q pairs to a byte: the sign bits of \a nbytes raw
+ * bytes, in stream order, fill nbytes / 8 bytes from bit 0 up, so pair j
+ * of a byte has its I in bit 2j and its Q in bit 2j + 1, set for -1. A
+ * last partial byte has its unused bits clear.
+ */
+typedef void (*gn3s_pack_fn)(const unsigned char *in, uint8_t *out, int nbytes);
+
+//! What each I or Q sample is written as
+enum gn3s_sample_format
+{
+	GN3S_FLOAT = 0,
+	GN3S_INT16,
+	GN3S_INT8,
+	GN3S_PACKED,	//!< 1 bit each, see gn3s_pack_fn
+	GN3S_RAW		//!< The GN3S bytes themselves, I first
+};
+
+//! Bytes taken by \a nsamp I/Q pairs written as \a format
+inline size_t gn3s_sample_bytes(gn3s_sample_format format, int nsamp)
+{
+	switch (format)
+	{
+		case GN3S_INT16:
+			return (size_t)nsamp * 2 * sizeof(int16_t);
+		case GN3S_INT8:
+			return (size_t)nsamp * 2 * sizeof(int8_t);
+		case GN3S_PACKED:
+			return (size_t)(nsamp + 3) / 4;
+		case GN3S_RAW:
+			return (size_t)nsamp * 2;
+		default:
+			return (size_t)nsamp * 2 * sizeof(float);
+	}
+}
+
+/*
+ * Bit 1 tells I bytes from Q bytes. A check kernel returns how many of
+ * the \a nbytes (an even number) starting with an I byte keep to the
+ * I, Q, I, Q order; the result is even as well.
+ */
+typedef int (*gn3s_check_fn)(const unsigned char *in, int nbytes);
+
+/*! \ingroup STRUCTS
+ *  @brief Unpack and check kernels for one instruction set */
+struct gn3s_unpack_kernel
+{
+	const char *name;
+	gn3s_unpack_fn fn;
+	gn3s_unpack16_fn fn16;
+	gn3s_unpack8_fn fn8;
+	gn3s_pack_fn pack;
+	gn3s_check_fn check;
+};
+
+void gn3s_unpack_generic(const unsigned char *in, float *out, int nbytes);
+void gn3s_unpack_sse2(const unsigned char *in, float *out, int nbytes);
+void gn3s_unpack_avx2(const unsigned char *in, float *out, int nbytes);
+void gn3s_unpack_avx512bw(const unsigned char *in, float *out, int nbytes);
+void gn3s_unpack_neon(const unsigned char *in, float *out, int nbytes);
+
+void gn3s_unpack16_generic(const unsigned char *in, int16_t *out, int nbytes);
+void gn3s_unpack16_sse2(const unsigned char *in, int16_t *out, int nbytes);
+void gn3s_unpack16_avx2(const unsigned char *in, int16_t *out, int nbytes);
+void gn3s_unpack16_avx512bw(const unsigned char *in, int16_t *out, int nbytes);
+void gn3s_unpack16_neon(const unsigned char *in, int16_t *out, int nbytes);
+
+void gn3s_unpack8_generic(const unsigned char *in, int8_t *out, int nbytes);
+void gn3s_unpack8_sse2(const unsigned char *in, int8_t *out, int nbytes);
+void gn3s_unpack8_avx2(const unsigned char *in, int8_t *out, int nbytes);
+void gn3s_unpack8_avx512bw(const unsigned char *in, int8_t *out, int nbytes);
+void gn3s_unpack8_neon(const unsigned char *in, int8_t *out, int nbytes);
+
+void gn3s_pack_generic(const unsigned char *in, uint8_t *out, int nbytes);
+void gn3s_pack_sse2(const unsigned char *in, uint8_t *out, int nbytes);
+void gn3s_pack_avx2(const unsigned char *in, uint8_t *out, int nbytes);
+void gn3s_pack_avx512bw(const unsigned char *in, uint8_t *out, int nbytes);
+void gn3s_pack_neon(const unsigned char *in, uint8_t *out, int nbytes);
+
+int gn3s_check_generic(const unsigned char *in, int nbytes);
+int gn3s_check_sse2(const unsigned char *in, int nbytes);
+int gn3s_check_avx2(const unsigned char *in, int nbytes);
+int gn3s_check_avx512bw(const unsigned char *in, int nbytes);
+int gn3s_check_neon(const unsigned char *in, int nbytes);
+
+/*--------------------------------------------------------------*/
+/*
+ * Scalar reference kernels, specialized at compile time on the output
+ * type and, for packed output, on the pairs the first byte already holds.
+ * Their loops have no branch on the data, so the compiler vectorizes them
+ * where there is no hand written kernel. The *_generic kernels are these,
+ * and the SIMD kernels are tested against them.
+ */
+template <typename T>
+inline void gn3s_unpack_ref(const unsigned char *in, T *out, int nbytes)
+{
+	static constexpr T lut[2] = { T(1), T(-1) };
+
+	for (int i = 0; i < nbytes; i++)
+		out[i] = lut[in[i] & 0x1];
+}
+
+//! Sign bits of 8 bytes, the first in bit 0; one multiply moves them all into the top byte
+inline uint8_t gn3s_pack8(const unsigned char *in)
+{
+	static constexpr uint64_t bit0 = 0x0101010101010101ULL;
+	static constexpr uint64_t gather = 0x0102040810204080ULL;
+	uint64_t x;
+
+	memcpy(&x, in, sizeof(x));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	x = __builtin_bswap64(x);
+#endif
+	return (uint8_t)(((x & bit0) * gather) >> 56);
+}
+
+//! As gn3s_pack_fn, but the first PHASE pairs of out[0] are kept and the stream follows them
+template <int PHASE>
+inline void gn3s_pack_ref(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	static_assert((PHASE >= 0) && (PHASE < 4), "a byte holds four pairs");
+	static constexpr int used = 2 * PHASE;
+	static constexpr uint8_t keep = (1 << used) - 1;
+	uint8_t b;
+	int i = 0, j;
+
+	if (PHASE != 0)
+	{
+		b = out[0] & keep;
+		for (; (i < 8 - used) && (i < nbytes); i++)
+			b |= (in[i] & 0x1) << (used + i);
+		*out++ = b;
+	}
+
+	for (; i + 8 <= nbytes; i += 8)
+		*out++ = gn3s_pack8(in + i);
+
+	/* Unused bits of a partial last byte stay clear */
+	if (i < nbytes)
+	{
+		b = 0;
+		for (j = 0; i + j < nbytes; j++)
+			b |= (in[i + j] & 0x1) << j;
+		*out = b;
+	}
+}
+/*--------------------------------------------------------------*/
+
+//! Kernels built in and supported by this CPU, slowest first
+std::vector<gn3s_unpack_kernel> gn3s_unpack_kernels();
+
+//! The fastest usable kernel, picked on first use
+const gn3s_unpack_kernel &gn3s_unpack_best();
+
+inline void gn3s_unpack(const unsigned char *in, float *out, int nbytes)
+{
+	gn3s_unpack_best().fn(in, out, nbytes);
+}
+
+
+/*--------------------------------------------------------------*/
+/*! \ingroup CLASSES
+ *
+ * Unpacks a byte stream handed over in arbitrary pieces while keeping
+ * track of the I/Q phase. An I byte ending one piece is kept and paired
+ * with the Q byte starting the next, so no sample is lost at the seams.
+ * The I/Q markers are checked on every byte; when the stream gets out of
+ * step the offending byte is dropped and the slip counted. Dropping bytes
+ * to find the phase at start up, or after reset(), is not a slip.
+ *
+ * Packed output only ever hands out whole bytes; up to three pairs
+ * wait in the tracker for the rest of their byte.
+ */
+class gn3s_iq_tracker
+{
+
+	private:
+
+		bool have_i;				//!< i_byte waits for its Q byte
+		unsigned char i_byte;
+		bool locked;				//!< In phase since the last reset
+		unsigned long long slips;	//!< Times the phase was lost
+		uint8_t pend_bits;			//!< Packed pairs short of a whole byte
+		int pend_n;					//!< How many, 0 to 3
+
+		void slip() { if (locked) slips++; locked = false; }
+
+		//! Write the pairs in \a nbytes at \a in as pairs n, n + 1... of \a out
+		void put(const gn3s_unpack_kernel &k, gn3s_sample_format format,
+				const unsigned char *in, int nbytes, void *out, int n);
+
+	public:
+
+		gn3s_iq_tracker() : have_i(false), i_byte(0), locked(false), slips(0),
+			pend_bits(0), pend_n(0) {}
+
+		//! Forget the stream so far, e.g. after a gap; slips are kept
+		void reset() { have_i = false; locked = false; pend_bits = 0; pend_n = 0; }
+
+		/*!
+		 * Unpack up to \a max_samples I/Q pairs from the \a nbytes at \a in
+		 * into \a out, written as \a format. Stores the pairs written in
+		 * *\a nsamp and returns the bytes used, which may be fewer than
+		 * \a nbytes once \a max_samples is reached. For GN3S_PACKED
+		 * \a max_samples is rounded down, and *\a nsamp comes out, to a
+		 * multiple of 4.
+		 */
+		int unpack(const unsigned char *in, int nbytes, void *out, gn3s_sample_format format,
+				int max_samples, int *nsamp);
+
+		unsigned long long get_slips() const { return slips; }
+
+};
+/*--------------------------------------------------------------*/
+
+#endif /* GN3S_UNPACK_H_ */
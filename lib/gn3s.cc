@@ -26,18 +26,23 @@
 /*----------------------------------------------------------------------------------------------*/
 
 #include "gn3s.h"
+#include "gn3s_defines.h"
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <system_error>
+#include <chrono>
+#include <algorithm>
+#include <vector>
 #include <libusb.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 static char debug = 1; //!< 1 = Verbose
 
-static libusb_context *ctx = nullptr;
-static unsigned char buffer[USB_NTRANSFERS][USB_BUFFER_SIZE];
-static int bcount;
-static int bufptr;
-
 /*----------------------------------------------------------------------------------------------*/
 /*!
  * All libusb callback functions should be marked with the LIBUSB_CALL macro
@@ -47,29 +52,78 @@ static int bufptr;
 //libusb_transfer_cb_fn
 static void LIBUSB_CALL callback(libusb_transfer *transfer)
 {
-    bcount += transfer->actual_length;
-    if (bcount >= sizeof(buffer))
-        bcount -= sizeof(buffer);
-    if (transfer->status == LIBUSB_TRANSFER_COMPLETED)
-    {
-        libusb_submit_transfer(transfer);
-    }
-    else
-    {
-        libusb_free_transfer(transfer);
-    }
+    static_cast<gn3s *>(transfer->user_data)->usb_fx2_transfer_done(transfer);
+}
+
+static void LIBUSB_CALL status_callback(libusb_transfer *transfer)
+{
+    static_cast<gn3s *>(transfer->user_data)->usb_fx2_status_done(transfer);
+}
+
+static int LIBUSB_CALL hotplug_callback(libusb_context *ctx, libusb_device *dev,
+        libusb_hotplug_event event, void *user_data)
+{
+    static_cast<gn3s *>(user_data)->usb_fx2_hotplug(dev, event);
+    return 0;   /* stay registered */
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-gn3s::gn3s(int _which)
+gn3s::gn3s(const std::string &_device, int _ntransfers, int _transfer_size, bool _dev_mem,
+        int _event_priority, const std::string &_firmware, int _renum_timeout)
 {
 
-        //int fsize;
 		bool ret;
         int r;
-		which = _which;
+		device = _device;
+		firmware = _firmware;
+		renum_timeout = (_renum_timeout > 0) ? _renum_timeout : USB_RENUM_TIMEOUT;
+		flashed_address = 0;
+		ctx = nullptr;
+		event_priority = _event_priority;
+		event_thread_run = false;
+		active_transfers = 0;
+		streaming = false;
+		xfer_running = false;
+		device_lost = false;
+		device_arrived = false;
+		reconnect_count = 0;
+		hotplug_registered = false;
+		status_xfer = nullptr;
+		data_waiters = 0;
+		data_wanted = 0;
+		data_fd = -1;
+		data_fd_armed = false;
+		data_fd_threshold = 0;
+		status_busy = false;
+		status_period = USB_STATUS_PERIOD;
+		rx_overrun_flag = false;
+		rx_overrun_count = 0;
+		lag_restart = true;
+		lag_valid = false;
+		lag_bytes = 0;
+		lag_normal = 0.0;
+
+		/* Bulk transfers must be whole USB packets */
+		ntransfers = (_ntransfers > 0) ? _ntransfers : USB_NTRANSFERS;
+		transfer_size = (_transfer_size / USB_BLOCK_SIZE) * USB_BLOCK_SIZE;
+		if (transfer_size <= 0)
+			transfer_size = USB_BLOCK_SIZE;
+		if (transfer_size != _transfer_size)
+			fprintf(stdout, "GN3S transfer size rounded to %d bytes\n", transfer_size);
+
+		transfer.assign(ntransfers, nullptr);
+		ring = nullptr;
+		discard = nullptr;
+		host_overrun_base = 0;
+		lost_base = 0;
+		ungapped_base = 0;
+		transfer_error_count = 0;
+		transfer_error_run = 0;
+		use_dev_mem = _dev_mem;
+		dev_mem = nullptr;
+		dev_mem_size = 0;
 
         fx2_device 	= nullptr;
         fx2_handle 	= nullptr;
@@ -79,7 +133,7 @@ gn3s::gn3s(int _which)
         r = libusb_init(&ctx);
         if (r < 0)
         {
-            printf("Libusb init error: %s\n", libusb_error_name(ret));
+            printf("Libusb init error: %s\n", libusb_error_name(r));
             throw (1);
         }
 
@@ -89,52 +143,55 @@ gn3s::gn3s(int _which)
         libusb_set_debug(ctx, 3);
 #endif
 
-        /* Get the firmware embedded in the executable */
-		//fstart = (int) &_binary_usrp_gn3s_firmware_ihx_start;
-		//fsize = strlen(_binary_usrp_gn3s_firmware_ihx_start);
-		//gn3s_firmware = new char[fsize + 10];
-		//memcpy(&gn3s_firmware[0], (void *)fstart, fsize);
-
-		// Load the firmware from external file (Javier)
-
+        /* Completions and hotplug events are only delivered while somebody
+           pumps libusb events, so start that before flashing the board: a
+           freshly flashed board is then picked up as soon as it is back */
+        ret = usb_event_thread_start();
+        if(!ret)
+        {
+            printf("Could not start USB event thread\n");
+            libusb_exit(ctx);
+            throw(1);
+        }
 
-		//gn3s_firmware[fsize] = NULL;
+        /* Watch for the board going away and coming back */
+        hotplug_registered = false;
+        if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+        {
+            r = libusb_hotplug_register_callback(ctx,
+                    (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+                    LIBUSB_HOTPLUG_NO_FLAGS, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+                    LIBUSB_HOTPLUG_MATCH_ANY, &hotplug_callback, this, &hotplug_handle);
+            if (r == LIBUSB_SUCCESS)
+                hotplug_registered = true;
+            else
+                printf("Could not register USB hotplug callback: %s\n", libusb_error_name(r));
+        }
 
-		/* Search all USB busses for the device specified by VID/PID */
-        fx2_device = usb_fx2_find(gn3s_vid, gn3s_pid, debug, 0);
-        if (!fx2_device)
+		/* Find, flash if needed, and open the board */
+		if (!usb_fx2_open(device))
 		{
-			/* Program the board */
-            ret = prog_gn3s_board();
-            if(ret)
-			{
-				fprintf(stdout, "Could not flash GN3S device\n");
-				throw(1);
-			}
-
-			/* Need to wait to catch change */
-			sleep(2);
-
-			/* Search all USB busses for the device specified by VID/PID */
-			fx2_device = usb_fx2_find(gn3s_vid, gn3s_pid, debug, 0);
+			if (hotplug_registered)
+				libusb_hotplug_deregister_callback(ctx, hotplug_handle);
+			usb_event_thread_stop();
+			libusb_exit(ctx);
+			throw(1);
 		}
-		else
 		{
-            fprintf(stdout, "Found GN3S Device\n");
+			std::lock_guard<std::mutex> lock(hotplug_lock);
+			device_path = usb_fx2_path(fx2_device);
 		}
 
-		/* Open and configure FX2 device if found... */
-		ret = usb_fx2_configure(fx2_device, &fx2_config);
-		if(ret)
-		{
-			fprintf(stdout, "Could not obtain a handle to the GN3S device\n");
-			throw(1);
-        }
-
         ret = usb_fx2_start_transfers();
         if(!ret)
         {
             printf("Could not start USB transfers\n");
+            if (hotplug_registered)
+                libusb_hotplug_deregister_callback(ctx, hotplug_handle);
+            usb_fx2_cancel_transfers();
+            usb_event_thread_stop();
+            usb_fx2_free_transfers();
+            usb_fx2_release_buffers();
             throw(1);
         }
 //TEST
@@ -148,218 +205,484 @@ gn3s::gn3s(int _which)
 gn3s::~gn3s()
 {
 
-	usrp_xfer(VRQ_XFER, 0);
+    if (hotplug_registered)
+        libusb_hotplug_deregister_callback(ctx, hotplug_handle);
 
-    usb_fx2_cancel_transfers();
-    usleep(1000);
+    if ((fx2_handle != nullptr) && !device_lost)
+        usrp_xfer(VRQ_XFER, 0);
 
-    libusb_release_interface(fx2_handle, RX_INTERFACE);
-    libusb_close(fx2_handle);
+    usb_fx2_cancel_transfers();
+    usb_event_thread_stop();
+    usb_fx2_close();
     libusb_exit(ctx);
 
+    if (data_fd >= 0)
+        close(data_fd);
+
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-int gn3s::prog_gn3s_board()
+/*!
+ * Find the board selected by \a spec, flash it if it still runs the boot
+ * firmware or firmware other than ours, then open and configure it and
+ * allocate its transfer buffers.
+ */
+bool gn3s::usb_fx2_open(const std::string &spec)
 {
+	bool ret;
+	gn3s_fw_image image;
+	unsigned char hash[GN3S_FW_HASH_SIZE];
+	std::string path;
 
-    unsigned char a;
-    unsigned int vid, pid;
-
-	vid = (VID_OLD);
-	pid = (PID_OLD);
+	if (!load_firmware(image))
+		return false;
+	gn3s_fw_hash(image, hash);
 
-    fx2_device = usb_fx2_find(vid, pid, debug, 0);
+	/* Search all USB busses for the device specified by VID/PID */
+	fx2_device = usb_fx2_find(gn3s_vid, gn3s_pid, spec);
+	if (fx2_device != nullptr)
+	{
+		fprintf(stdout, "Found GN3S Device\n");
+		ret = usb_fx2_configure(fx2_device, &fx2_config);
+		if (ret)
+		{
+			/* Busy or inaccessible, likely streaming elsewhere: leave it alone */
+			fprintf(stdout, "Could not obtain a handle to the GN3S device\n");
+			libusb_unref_device(fx2_device);
+			fx2_device = nullptr;
+			return false;
+		}
+		if (firmware_matches(hash))
+		{
+			/* Transfer buffers may need the device handle */
+			usb_fx2_alloc_buffers();
+			return true;
+		}
 
-    if(fx2_device == nullptr)
+		/* Running something else, load ours over it */
+		fprintf(stdout, "GN3S firmware differs from ours, reloading\n");
+		path = usb_fx2_path(fx2_device);
+		usb_fx2_close();
+		ret = prog_gn3s_board(gn3s_vid, gn3s_pid, path, image, hash);
+	}
+	else
 	{
-		fprintf(stderr,"Cannot find vid 0x%x pid 0x%x \n", vid, pid);
-		return -1;
+		/* Program the board */
+		ret = prog_gn3s_board(VID_OLD, PID_OLD, spec, image, hash);
+	}
+	if(ret)
+	{
+		fprintf(stdout, "Could not flash GN3S device\n");
+		return false;
 	}
 
-//	printf("Using device vendor id 0x%04x product id 0x%04x\n",
-//			fx2_device->descriptor.idVendor, fx2_device->descriptor.idProduct);
+	/* The board renumerates on the same port it was flashed on */
+	fx2_device = usb_fx2_wait(gn3s_vid, gn3s_pid, flashed_path, renum_timeout);
 
-    int ret = libusb_open(fx2_device, &fx2_handle);
+	/* Open and configure FX2 device if found... */
+	if (fx2_device == nullptr)
+	{
+		fprintf(stdout, "Could not find GN3S device \"%s\"\n", spec.c_str());
+		return false;
+	}
+	ret = usb_fx2_configure(fx2_device, &fx2_config);
+	if(ret)
+	{
+		fprintf(stdout, "Could not obtain a handle to the GN3S device\n");
+		libusb_unref_device(fx2_device);
+		fx2_device = nullptr;
+		fx2_handle = nullptr;
+		return false;
+	}
 
-	/* Do the first set 0xE600 1 */
-	char c[] = "1";
-	char d[] = "0";
+	/* Transfer buffers may need the device handle */
+	usb_fx2_alloc_buffers();
+	return true;
+}
+/*----------------------------------------------------------------------------------------------*/
 
-	a = atoz(c);
 
-	fprintf(stdout,"GN3S flashing ... \n");
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Wait up to \a timeout ms for a freshly flashed board to renumerate at
+ * USB port \a path. The device list is polled every USB_RENUM_POLL ms, or
+ * as soon as a hotplug arrival on our port is reported. A board still
+ * holding the bus address it had when it was flashed has not dropped off
+ * the bus yet and does not count.
+ */
+struct libusb_device* gn3s::usb_fx2_wait(unsigned int vid, unsigned int pid,
+        const std::string &path, int timeout)
+{
+    std::chrono::steady_clock::time_point deadline;
+    struct libusb_device *dev;
 
-	upload_ram(&a, (PROG_SET_CMD),1);
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    for (;;)
+    {
+        dev = usb_fx2_find(vid, pid, path);
+        if (dev != nullptr)
+        {
+            if (libusb_get_device_address(dev) != flashed_address)
+                return dev;
+            libusb_unref_device(dev);
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
 
-    program_fx2(nullptr, 1);
+        std::unique_lock<std::mutex> lock(hotplug_lock);
+        hotplug_cond.wait_for(lock, std::chrono::milliseconds(USB_RENUM_POLL),
+                [this] { return device_arrived.load(); });
+        device_arrived = false;
+    }
 
-	a = atoz(d);
+    fprintf(stdout, "GN3S device did not come back at %s within %d ms\n", path.c_str(), timeout);
+    return nullptr;
+}
+/*----------------------------------------------------------------------------------------------*/
 
-	upload_ram(&a, (PROG_SET_CMD),1);
 
-	fprintf(stdout,"GN3S flash complete! \n");
+/*----------------------------------------------------------------------------------------------*/
+//! Undo usb_fx2_open(). Transfers must have been reaped already.
+void gn3s::usb_fx2_close()
+{
+    usb_fx2_free_transfers();
+    if (fx2_handle != nullptr)
+    {
+        usb_fx2_release_buffers();
+        libusb_release_interface(fx2_handle, RX_INTERFACE);
+        libusb_close(fx2_handle);
+        fx2_handle = nullptr;
+    }
+    if (fx2_device != nullptr)
+        libusb_unref_device(fx2_device);
+    fx2_device = nullptr;
+}
+/*----------------------------------------------------------------------------------------------*/
 
-    libusb_close(fx2_handle);
 
-	return(0);
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Hotplug notification, called from the event thread. Only flags are set
+ * here; the reader does the actual work in usb_fx2_wait() or
+ * usb_fx2_recover(). Arrivals count on the port we stream from and on
+ * the one a board we just flashed will come back on.
+ */
+void gn3s::usb_fx2_hotplug(struct libusb_device *dev, int event)
+{
+    libusb_device_descriptor desc = {0};
+    std::string path;
+
+    if (libusb_get_device_descriptor(dev, &desc) != 0)
+        return;
+    if (!(((desc.idVendor == GN3S_VID) && (desc.idProduct == GN3S_PID)) ||
+          ((desc.idVendor == VID_OLD) && (desc.idProduct == PID_OLD))))
+        return;
+    path = usb_fx2_path(dev);
+
+    std::lock_guard<std::mutex> lock(hotplug_lock);
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT)
+    {
+        if (path != device_path)
+            return;
+        if (!device_lost)
+            printf("GN3S device at %s removed\n", device_path.c_str());
+        device_lost = true;
+        usb_fx2_wake(true);
+    }
+    else
+    {
+        if ((path != device_path) && (path != flashed_path))
+            return;
+        device_arrived = true;
+        hotplug_cond.notify_all();
+    }
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-int gn3s::atoz(char *s)
+/*!
+ * Bring a lost board back. Called by the reader once it has drained the
+ * ring, so the ring memory can be reallocated under it. Waits at most
+ * USB_EVENT_TIMEOUT for the board to show up again and returns true once
+ * it is streaming.
+ */
+bool gn3s::usb_fx2_recover()
 {
-    int a;
-    if(!strncasecmp("0x", s, 2)){
-        sscanf(s, "%x",&a);
-        return a;
+    struct libusb_device *dev;
+    bool present;
+
+    /* Let the transfers of the dead handle be reaped, and read what they got */
+    if (fx2_handle != nullptr)
+    {
+        usb_fx2_cancel_transfers();
+        for (int i = 0; (i < USB_TIMEOUT) && (active_transfers > 0); i++)
+            usleep(1000);
+        if ((active_transfers > 0) || (ring->fill() > 0))
+            return false;
+        usb_fx2_close();
+    }
+
+    /* Wait for the board to reappear on its port */
+    {
+        std::unique_lock<std::mutex> lock(hotplug_lock);
+        hotplug_cond.wait_for(lock, std::chrono::milliseconds(USB_EVENT_TIMEOUT),
+                [this] { return device_arrived.load(); });
+        device_arrived = false;
+    }
+    dev = usb_fx2_find(GN3S_VID, GN3S_PID, device_path);
+    if (dev == nullptr)
+        dev = usb_fx2_find(VID_OLD, PID_OLD, device_path);
+    present = (dev != nullptr);
+    if (dev != nullptr)
+        libusb_unref_device(dev);
+    if (!present)
+        return false;
+
+    printf("GN3S device at %s is back, reconnecting\n", device_path.c_str());
+    if (!usb_fx2_open(device_path))
+        return false;
+
+    if (!usb_fx2_start_transfers())
+    {
+        usb_fx2_cancel_transfers();
+        return false;
     }
-    return atoi(s);
+    if (xfer_running)
+        usrp_xfer(VRQ_XFER, 1);
+
+    device_lost = false;
+    reconnect_count++;
+    return true;
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-void gn3s::upload_ram(unsigned char *buf, int start, int len)
+//! The firmware to run: built into the library unless overridden by a file
+bool gn3s::load_firmware(gn3s_fw_image &image)
 {
-	int i;
-    int tlen;
-	int quanta = 16;
-	int a;
+    std::string error;
 
-	for (i = start; i < start + len; i += quanta) {
-		tlen = len + start - i;
+    if (firmware.empty())
+    {
+        image.resize(gn3s_firmware_nsegments);
+        for (int i = 0; i < gn3s_firmware_nsegments; i++)
+        {
+            image[i].addr = gn3s_firmware_segments[i].addr;
+            image[i].data.assign(gn3s_firmware_segments[i].data,
+                    gn3s_firmware_segments[i].data + gn3s_firmware_segments[i].len);
+        }
+    }
+    else if (!gn3s_ihex_load(firmware.c_str(), image, error))
+    {
+        /* Parse the whole file before touching the board */
+        fprintf(stderr, "Could not load GN3S firmware: %s\n", error.c_str());
+        return false;
+    }
+    return true;
+}
+/*----------------------------------------------------------------------------------------------*/
 
-		if (tlen > quanta)
-			tlen = quanta;
 
-		if (debug >= 3)
-			printf("i = %d, tlen = %d \n", i, tlen);
-        a = libusb_control_transfer(fx2_handle, 0x40, 0xa0, i, 0,
-				buf + (i - start), tlen, 1000);
+/*----------------------------------------------------------------------------------------------*/
+//! Whether the open board holds \a hash in its first hash slot
+bool gn3s::firmware_matches(const unsigned char *hash)
+{
+    unsigned char slot[GN3S_FW_HASH_SIZE];
 
-		if (a < 0) {
-			fprintf(stderr, "Request to upload ram contents failed: %s\n",
-                    libusb_error_name(a));
-			return;
-		}
-	}
+    if (write_cmd(VRQ_RAM, USRP_HASH_SLOT_0_ADDR, 0, slot, sizeof(slot)) != sizeof(slot))
+        return false;
+    return memcmp(slot, hash, sizeof(slot)) == 0;
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-void gn3s::program_fx2(char *filename, char mem)
+/*!
+ * Load \a image into the board \a spec with the given IDs and record
+ * \a hash next to it, so the next open can tell it is already there.
+ */
+int gn3s::prog_gn3s_board(unsigned int vid, unsigned int pid, const std::string &spec,
+        const gn3s_fw_image &image, const unsigned char *hash)
 {
-	FILE *f;
-	char s[1024];
-    unsigned char data[256];
-	char checksum, a;
-	int length, addr, type, i;
-	unsigned int b;
 
-	// *** mod javier: load firmware from external file ***
+    unsigned char a;
+    bool ok;
+
+    fx2_device = usb_fx2_find(vid, pid, spec);
+
+    if(fx2_device == nullptr)
+	{
+		fprintf(stderr,"Cannot find vid 0x%x pid 0x%x \n", vid, pid);
+		return -1;
+	}
+    {
+        /* Read by the hotplug callback on the event thread */
+        std::lock_guard<std::mutex> lock(hotplug_lock);
+        flashed_path = usb_fx2_path(fx2_device);
+    }
+    flashed_address = libusb_get_device_address(fx2_device);
+
+    int ret = libusb_open(fx2_device, &fx2_handle);
+    if (ret < 0)
+    {
+        fprintf(stderr, "Could not open FX2 for flashing: %s\n", libusb_error_name(ret));
+        libusb_unref_device(fx2_device);
+        fx2_device = nullptr;
+        fx2_handle = nullptr;
+        return -1;
+    }
 
-	//f = tmpfile();
+	fprintf(stdout,"GN3S flashing ... \n");
 
-	/* Dump firmware into temp file */
-	//fputs(gn3s_firmware, f);
-	//rewind(f);
+	/* Hold the 8051 in reset, load every segment, then let it run */
+	a = 1;
+	ok = upload_ram(&a, PROG_SET_CMD, 1);
+	if (ok)
+		ok = program_fx2(image);
+	if (ok)
+		ok = upload_ram(hash, USRP_HASH_SLOT_0_ADDR, GN3S_FW_HASH_SIZE);
+	a = 0;
+	if (ok)
+		ok = upload_ram(&a, PROG_SET_CMD, 1);
 
-	  f = fopen ("gn3s_firmware.ihx","r");
-      if (f!=nullptr)
-	  {
-		printf("GN3S firmware file found!\n");
-	  }else{
-		  printf("Could not open GN3S firmware file!\n");
-		  return;
-	  }
+	if (ok)
+		fprintf(stdout,"GN3S flash complete! \n");
 
-	while (!feof(f)) {
-		fgets(s, 1024, f); /* we should not use more than 263 bytes normally */
+    libusb_close(fx2_handle);
+    fx2_handle = nullptr;
+    libusb_unref_device(fx2_device);
+    fx2_device = nullptr;
+
+	return(ok ? 0 : -1);
+}
+/*----------------------------------------------------------------------------------------------*/
 
-		if (s[0] != ':') {
-			fprintf(stderr, "%s: invalid string: \"%s\"\n", filename, s);
-			continue;
-		}
 
-		sscanf(s + 1, "%02x", &length);
-		sscanf(s + 3, "%04x", &addr);
-		sscanf(s + 7, "%02x", &type);
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s::upload_ram(const unsigned char *buf, int start, int len)
+{
+	int i;
+    int tlen;
+	int a;
 
-		if (type == 0) {
-			// printf("Programming %3d byte%s starting at 0x%04x",
-			//     length, length==1?" ":"s", addr);
-			a = length + (addr & 0xff) + (addr >> 8) + type;
+	for (i = start; i < start + len; i += FX2_UPLOAD_CHUNK) {
+		tlen = len + start - i;
 
-			for (i = 0; i < length; i++) {
-				sscanf(s + 9 + i * 2, "%02x", &b);
-				data[i] = b;
-				a = a + data[i];
-            }
+		if (tlen > FX2_UPLOAD_CHUNK)
+			tlen = FX2_UPLOAD_CHUNK;
 
-			sscanf(s + 9 + length * 2, "%02x", &b);
-            checksum = b;
-
-			if (((a + checksum) & 0xff) != 0x00) {
-				printf("  ** Checksum failed: got 0x%02x versus 0x%02x\n", (-a)
-						& 0xff, checksum);
-				continue;
-			} else {
-				//printf(", checksum ok\n");
-			}
-
-			upload_ram(data, addr, length);
-
-		} else {
-			if (type == 0x01) {
-				printf("End of file\n");
-				fclose(f);
-
-				return;
-			} else {
-				if (type == 0x02) {
-					printf("Extended address: whatever I do with it ?\n");
-                    continue;
-				}
-			}
+		if (debug >= 3)
+			printf("i = %d, tlen = %d \n", i, tlen);
+        a = libusb_control_transfer(fx2_handle, 0x40, 0xa0, i, 0,
+				(unsigned char *)buf + (i - start), tlen, USB_TIMEOUT);
+
+		if (a != tlen) {
+			fprintf(stderr, "Request to upload ram contents failed: %s\n",
+                    (a < 0) ? libusb_error_name(a) : "short write");
+			return false;
 		}
 	}
+	return true;
+}
+/*----------------------------------------------------------------------------------------------*/
+
 
-	fclose(f);
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s::program_fx2(const gn3s_fw_image &image)
+{
+	for (unsigned int i = 0; i < image.size(); i++)
+	{
+		if (!upload_ram(image[i].data.data(), image[i].addr, image[i].data.size()))
+			return false;
+	}
+	return true;
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-struct libusb_device* gn3s::usb_fx2_find(unsigned int vid, unsigned int pid, char info, int ignore)
+/*!
+ * Find a board by VID/PID. \a spec picks one when several are plugged in:
+ * an empty string takes the first, a number is an index, "bus-port[.port]"
+ * (as in /sys/bus/usb/devices) a physical port, anything else is matched
+ * against the serial number. Boards are ordered by bus and port so
+ * indices do not change from one run to the next. The returned device
+ * holds a reference the caller must drop with libusb_unref_device().
+ */
+struct libusb_device* gn3s::usb_fx2_find(unsigned int vid, unsigned int pid, const std::string &spec)
 {
     libusb_device **devs;
     struct libusb_device *fx2 = nullptr;
+    std::vector<std::pair<std::vector<int>, libusb_device *> > found;
+    libusb_device_handle *handle;
+    unsigned char serial[256];
+    uint8_t ports[8];
     long count = 0;
-    int ret;
+    int ret, nports;
+    bool is_index, is_path;
+
+    is_index = !spec.empty() && (spec.find_first_not_of("0123456789") == std::string::npos);
+    is_path = (spec.find('-') != std::string::npos) &&
+              (spec.find_first_not_of("0123456789-.") == std::string::npos);
 
     count = libusb_get_device_list(ctx, &devs);
     if (count < 0)
     {
         printf("Unable to list devices\n");;
+        return nullptr;
     }
-    else
+
+    for (int idx=0; idx < count; ++idx)
+    {
+        libusb_device *dev = devs[idx];
+        libusb_device_descriptor desc = {0};
+
+        ret = libusb_get_device_descriptor (dev, &desc);
+        if ((ret != 0) || (desc.idVendor != vid) || (desc.idProduct != pid))
+            continue;
+
+        std::vector<int> key(1, libusb_get_bus_number(dev));
+        nports = libusb_get_port_numbers(dev, ports, sizeof(ports));
+        for (int i = 0; i < nports; i++)
+            key.push_back(ports[i]);
+        found.push_back(std::make_pair(key, dev));
+    }
+    std::sort(found.begin(), found.end());
+
+    for (unsigned int i = 0; (i < found.size()) && (fx2 == nullptr); i++)
     {
-        for (int idx=0; idx < count; ++idx)
+        libusb_device *dev = found[i].second;
+
+        if (spec.empty())
+            fx2 = dev;
+        else if (is_index)
+            fx2 = (i == strtoul(spec.c_str(), nullptr, 10)) ? dev : nullptr;
+        else if (is_path)
+            fx2 = (usb_fx2_path(dev) == spec) ? dev : nullptr;
+        else if (libusb_open(dev, &handle) == 0)
         {
-            libusb_device *dev = devs[idx];
             libusb_device_descriptor desc = {0};
-
-            ret = libusb_get_device_descriptor (dev, &desc);
-            if ((desc.idVendor == vid) && (desc.idProduct == pid))
-                 fx2 = dev;
+            libusb_get_device_descriptor(dev, &desc);
+            ret = 0;
+            if (desc.iSerialNumber != 0)
+                ret = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber,
+                        serial, sizeof(serial));
+            if ((ret > 0) && (spec == std::string((char *)serial, ret)))
+                fx2 = dev;
+            libusb_close(handle);
         }
     }
 
+    if (fx2 != nullptr)
+    {
+        libusb_ref_device(fx2);
+        if (debug)
+            printf("Found device 0x%04x:0x%04x at %s\n", vid, pid, usb_fx2_path(fx2).c_str());
+    }
     libusb_free_device_list(devs, 1);
 
 	return fx2;
@@ -367,55 +690,146 @@ struct libusb_device* gn3s::usb_fx2_find(unsigned int vid, unsigned int pid, cha
 /*----------------------------------------------------------------------------------------------*/
 
 
+/*----------------------------------------------------------------------------------------------*/
+//! Physical location of \a dev, in the "bus-port.port" form used by sysfs
+std::string gn3s::usb_fx2_path(struct libusb_device *dev)
+{
+    uint8_t ports[8];
+    char part[8];
+    std::string path;
+    int nports;
+
+    snprintf(part, sizeof(part), "%d", libusb_get_bus_number(dev));
+    path = part;
+    nports = libusb_get_port_numbers(dev, ports, sizeof(ports));
+    for (int i = 0; i < nports; i++)
+    {
+        snprintf(part, sizeof(part), "%c%d", (i == 0) ? '-' : '.', ports[i]);
+        path += part;
+    }
+    return path;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
 /*----------------------------------------------------------------------------------------------*/
 bool gn3s::usb_fx2_configure(struct libusb_device *fx2, fx2Config *fx2c)
 {
 
-  char status = 0;
   int ret;
 
   ret = libusb_open(fx2_device, &fx2_handle);
 
   if(ret != 0)
   {
-      printf("Could not obtain a handle to GNSS Front-End device \n");
+      printf("Could not obtain a handle to GNSS Front-End device: %s\n", libusb_error_name(ret));
+      fx2_handle = nullptr;
       return -1;
   }
-  else
+
+  if(debug)
+	  printf("Received handle for GNSS Front-End device \n");
+
+  /* Stop at the first failure, the handle is closed and no longer usable */
+  ret = libusb_set_configuration (fx2_handle, 1);
+  if(ret != 0)
   {
-	  if(debug)
-		  printf("Received handle for GNSS Front-End device \n");
-
-      ret = libusb_set_configuration (fx2_handle, 1);
-      if(ret != 0)
-      {
-          printf("FX2 configure error: %s\n", libusb_error_name(ret));
-          libusb_close (fx2_handle);
-          status = -1;
-      }
-
-      ret = libusb_claim_interface (fx2_handle, RX_INTERFACE);
-      if (ret < 0)
-      {
-          printf("Interface claim error: %s\n", libusb_error_name(ret));
-          printf ("\nDevice not programmed? \n");
-          libusb_close (fx2_handle);
-          status = -1;
-      }
+      printf("FX2 configure error: %s\n", libusb_error_name(ret));
+      libusb_close (fx2_handle);
+      fx2_handle = nullptr;
+      return -1;
+  }
+
+  ret = libusb_claim_interface (fx2_handle, RX_INTERFACE);
+  if (ret < 0)
+  {
+      printf("Interface claim error: %s\n", libusb_error_name(ret));
+      if (ret == LIBUSB_ERROR_BUSY)
+          printf ("\nDevice in use by another program? \n");
       else
-          printf("Claimed interface\n");
-
-      ret = libusb_set_interface_alt_setting(fx2_handle, RX_INTERFACE, RX_ALTINTERFACE);
-      if (ret !=0)
-      {
-          printf ("Failed to start alternate setting: %s\n", libusb_error_name(ret));
-          libusb_release_interface (fx2_handle, RX_INTERFACE);
-          libusb_close (fx2_handle);
-          status = -1;
-      }
-
-      return status;
+          printf ("\nDevice not programmed? \n");
+      libusb_close (fx2_handle);
+      fx2_handle = nullptr;
+      return -1;
+  }
+  printf("Claimed interface\n");
+
+  ret = libusb_set_interface_alt_setting(fx2_handle, RX_INTERFACE, RX_ALTINTERFACE);
+  if (ret !=0)
+  {
+      printf ("Failed to start alternate setting: %s\n", libusb_error_name(ret));
+      libusb_release_interface (fx2_handle, RX_INTERFACE);
+      libusb_close (fx2_handle);
+      fx2_handle = nullptr;
+      return -1;
   }
+
+  return 0;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Allocate the ring slots and the discard buffer. When asked to, and the
+ * kernel supports it, they live in one block of memory mapped by usbfs so
+ * completed transfers need no copy from kernel to user space.
+ */
+void gn3s::usb_fx2_alloc_buffers()
+{
+    int nslots = USB_RING_FACTOR * ntransfers;
+
+    dev_mem = nullptr;
+    dev_mem_size = (size_t)(nslots + 1) * transfer_size;
+#if LIBUSB_API_VERSION >= 0x01000105
+    if (use_dev_mem)
+    {
+        dev_mem = libusb_dev_mem_alloc(fx2_handle, dev_mem_size);
+        if (dev_mem == nullptr)
+            printf("Kernel mapped USB buffers not available, using regular memory\n");
+        else if (debug)
+            printf("Using %lu bytes of kernel mapped USB buffers\n", (unsigned long)dev_mem_size);
+    }
+#endif
+
+    if (dev_mem != nullptr)
+    {
+        ring = new gn3s_ring(nslots, transfer_size, dev_mem);
+        discard = dev_mem + (size_t)nslots * transfer_size;
+    }
+    else
+    {
+        ring = new gn3s_ring(nslots, transfer_size);
+        discard = new unsigned char[transfer_size];
+    }
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s::usb_fx2_release_buffers()
+{
+    if (ring != nullptr)
+    {
+        host_overrun_base += ring->get_overruns();
+        lost_base += ring->get_lost_bytes();
+        ungapped_base += ring->get_ungapped_overruns();
+    }
+    delete ring;
+    ring = nullptr;
+
+    if (dev_mem == nullptr)
+    {
+        delete[] discard;
+    }
+#if LIBUSB_API_VERSION >= 0x01000105
+    else
+    {
+        libusb_dev_mem_free(fx2_handle, dev_mem, dev_mem_size);
+        dev_mem = nullptr;
+    }
+#endif
+    discard = nullptr;
 }
 /*----------------------------------------------------------------------------------------------*/
 
@@ -423,20 +837,27 @@ bool gn3s::usb_fx2_configure(struct libusb_device *fx2, fx2Config *fx2c)
 /*----------------------------------------------------------------------------------------------*/
 bool gn3s::usb_fx2_start_transfers()
 {
-    int ret;
+    int ret, idx;
     bool success = true;
-    bufptr = 0;
-    bcount = 0;
+    ring->reset();
+    rx_overrun_flag = false;
+    transfer_error_run = 0;
+    status_xfer = libusb_alloc_transfer(0);
+    streaming = true;
 
-    for (int i = 0; i < USB_NTRANSFERS; i++)
+    for (int i = 0; i < ntransfers; i++)
     {
+        idx = ring->claim();
         transfer[i] = libusb_alloc_transfer(0);
-        libusb_fill_bulk_transfer(transfer[i], fx2_handle, RX_ENDPOINT, buffer[i],
-                USB_BUFFER_SIZE, libusb_transfer_cb_fn(&callback), nullptr, 1000);
+        libusb_fill_bulk_transfer(transfer[i], fx2_handle, RX_ENDPOINT, ring->slot(idx),
+                transfer_size, libusb_transfer_cb_fn(&callback), this, 1000);
+        active_transfers++;
         ret = libusb_submit_transfer(transfer[i]);
         if (ret != 0)
         {
             printf ("Failed to start endpoint streaming: %s\n", libusb_error_name(ret));
+            ring->commit(idx, 0);
+            active_transfers--;
             success = false;
         }
     }
@@ -450,35 +871,450 @@ bool gn3s::usb_fx2_cancel_transfers()
 {
     int ret;
     bool success = true;
-    for (int i = 0; i < USB_NTRANSFERS; i++)
+
+    /* Stop the callback from resubmitting what we are about to cancel, and
+       the event thread from starting a status poll once we are past here */
     {
+        std::lock_guard<std::mutex> lock(status_lock);
+        streaming = false;
+    }
+    for (int i = 0; i < ntransfers; i++)
+    {
+        if (transfer[i] == nullptr)
+            continue;
         ret = libusb_cancel_transfer(transfer[i]);
-        if (ret != 0)
+        if ((ret != 0) && (ret != LIBUSB_ERROR_NOT_FOUND))
         {
             printf ("Failed to cancel transfer: %s\n", libusb_error_name(ret));
             success = false;
         }
     }
+    if (status_busy)
+        libusb_cancel_transfer(status_xfer);
     return (success);
 }
 /*----------------------------------------------------------------------------------------------*/
 
 
 /*----------------------------------------------------------------------------------------------*/
-int gn3s::read(unsigned char *buff, int bytes)
+void gn3s::usb_fx2_free_transfers()
 {
-    int n;
-    if (bcount < bufptr)
-        n = bcount +sizeof(buffer) - bufptr;
+    for (int i = 0; i < ntransfers; i++)
+    {
+        if (transfer[i] != nullptr)
+            libusb_free_transfer(transfer[i]);
+        transfer[i] = nullptr;
+    }
+    if (status_xfer != nullptr)
+        libusb_free_transfer(status_xfer);
+    status_xfer = nullptr;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Called from the event thread for every completed bulk transfer. The
+ * payload is published to the ring and the transfer is resubmitted into
+ * the next free slot, or into the discard buffer if the reader is a whole
+ * ring behind.
+ */
+void gn3s::usb_fx2_transfer_done(struct libusb_transfer *xfer)
+{
+    int idx;
+
+    idx = ring->slot_of(xfer->buffer);
+    if (idx < 0)
+        ring->drop(xfer->actual_length);
     else
-        n = bcount - bufptr;
-    if (n > bytes)
-        n = bytes;
-    for (int i=0; i<n; i++)
+        ring->commit(idx, xfer->actual_length);
+
+    /* Timeouts are expected until streaming is switched on with VRQ_XFER */
+    if ((xfer->status == LIBUSB_TRANSFER_COMPLETED) || (xfer->status == LIBUSB_TRANSFER_TIMED_OUT))
+        transfer_error_run = 0;
+    else if (xfer->status == LIBUSB_TRANSFER_NO_DEVICE)
+    {
+        transfer_error_count++;
+        device_lost = true;
+    }
+    else if (xfer->status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        /* Errors, stalls and overflows come from glitches; reopen the board if they persist */
+        transfer_error_count++;
+        if ((++transfer_error_run > USB_XFER_RETRIES) && !device_lost)
+        {
+            printf("GN3S transfers keep failing (%s), reopening the device\n",
+                    libusb_error_name(xfer->status));
+            device_lost = true;
+        }
+    }
+
+    usb_fx2_wake(false);
+
+    if ((xfer->status != LIBUSB_TRANSFER_CANCELLED) && (xfer->status != LIBUSB_TRANSFER_NO_DEVICE) &&
+        streaming && !device_lost)
+    {
+        idx = ring->claim();
+        xfer->buffer = (idx < 0) ? discard : ring->slot(idx);
+        if (libusb_submit_transfer(xfer) == 0)
+            return;
+        if (idx >= 0)
+            ring->commit(idx, 0);
+    }
+
+    /* The transfer is freed by usb_fx2_free_transfers() */
+    active_transfers--;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Ask the FX2 for its overrun status without blocking. Called from the
+ * event thread; the answer arrives in usb_fx2_status_done(). The poll is
+ * counted in active_transfers before the lock is dropped, so whoever
+ * stops the stream either prevents it or waits for it to be reaped
+ * before freeing status_xfer and closing the handle.
+ */
+void gn3s::usb_fx2_poll_status()
+{
+    int ret;
+    std::lock_guard<std::mutex> lock(status_lock);
+
+    if (!streaming || status_busy || (status_xfer == nullptr))
+        return;
+
+    libusb_fill_control_setup(status_buf, VRT_VENDOR_IN, VRQ_GET_STATUS, 0, GS_RX_OVERRUN, 1);
+    libusb_fill_control_transfer(status_xfer, fx2_handle, status_buf,
+            libusb_transfer_cb_fn(&status_callback), this, USB_TIMEOUT);
+
+    status_busy = true;
+    active_transfers++;
+    ret = libusb_submit_transfer(status_xfer);
+    if (ret != 0)
+    {
+        if (debug)
+            printf("Failed to poll GN3S status: %s\n", libusb_error_name(ret));
+        active_transfers--;
+        status_busy = false;
+    }
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s::usb_fx2_status_done(struct libusb_transfer *xfer)
+{
+    bool overrun;
+
+    if ((xfer->status == LIBUSB_TRANSFER_COMPLETED) && (xfer->actual_length >= 1))
     {
-        buff[i] = buffer[0][bufptr++];
-        if (bufptr == sizeof(buffer))
-            bufptr = 0;
+        overrun = (libusb_control_transfer_get_data(xfer)[0] != 0);
+        rx_overrun_flag = overrun;
+        usb_fx2_estimate_loss(overrun);
+        if (overrun)
+            rx_overrun_count++;
+    }
+
+    status_busy = false;
+    active_transfers--;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * The FX2 does not say how much it lost in an overrun. Once streaming,
+ * the bytes received should follow the host clock at two bytes per
+ * sample; how far they lag behind it is steady apart from USB latency
+ * and clock drift. An overrun shows as a jump in the lag since the last
+ * clean poll, which is recorded as missing from the stream. Without a
+ * reference, or when USB latency hides the jump, the overrun is still
+ * recorded, with no gap. Returns true if it left a gap. Called from the
+ * event thread, the ring's producer.
+ */
+bool gn3s::usb_fx2_estimate_loss(bool overrun)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    unsigned long long bytes;
+    double lag, lost;
+
+    if ((ring == nullptr) || !xfer_running)
+        return false;
+
+    /* Dropped and lost bytes count as delivered, they are accounted for */
+    bytes = ring->get_bytes_in() + ring->get_lost_bytes();
+    if (lag_restart.exchange(false) || !lag_valid || (bytes < lag_bytes))
+    {
+        lag_valid = !overrun;
+        lag_time = now;
+        lag_bytes = bytes;
+        lag_normal = 0.0;
+        if (overrun)
+            ring->overrun(0);
+        return false;
+    }
+
+    lag = std::chrono::duration<double>(now - lag_time).count() * 2.0 * GN3S_SAMPLE_RATE -
+            (double)(bytes - lag_bytes);
+    if (!overrun)
+    {
+        lag_normal = lag;
+        return false;
+    }
+
+    lost = lag - lag_normal;
+    return ring->overrun((lost >= 2.0) ? ((unsigned long long)lost & ~1ULL) : 0);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s::usb_event_thread_start()
+{
+    struct sched_param param;
+    int min, max, r;
+
+    event_thread_run = true;
+    try
+    {
+        event_thread = std::thread(&gn3s::usb_event_loop, this);
+    }
+    catch (const std::system_error &e)
+    {
+        printf("Could not create USB event thread: %s\n", e.what());
+        event_thread_run = false;
+        return false;
+    }
+
+    if (event_priority > 0)
+    {
+        min = sched_get_priority_min(SCHED_FIFO);
+        max = sched_get_priority_max(SCHED_FIFO);
+        param.sched_priority = event_priority;
+        if (param.sched_priority < min)
+            param.sched_priority = min;
+        if (param.sched_priority > max)
+            param.sched_priority = max;
+
+        r = pthread_setschedparam(event_thread.native_handle(), SCHED_FIFO, &param);
+        if (r != 0)
+            printf("Could not set USB event thread priority to %d: %s\n",
+                    param.sched_priority, strerror(r));
+        else if (debug)
+            printf("USB event thread running at SCHED_FIFO priority %d\n", param.sched_priority);
+    }
+
+    return true;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s::usb_event_thread_stop()
+{
+    if (!event_thread.joinable())
+        return;
+
+    /* Let the event thread reap cancelled transfers before it exits */
+    for (int i = 0; (i < USB_TIMEOUT) && (active_transfers > 0); i++)
+        usleep(1000);
+
+    event_thread_run = false;
+#if LIBUSB_API_VERSION >= 0x01000105
+    libusb_interrupt_event_handler(ctx);
+#endif
+    event_thread.join();
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s::usb_event_loop()
+{
+    struct timeval tv;
+    int r, period, timeout;
+    std::chrono::steady_clock::time_point now, next_status;
+
+    next_status = std::chrono::steady_clock::now();
+    while (event_thread_run)
+    {
+        period = status_period;
+        timeout = ((period > 0) && (period < USB_EVENT_TIMEOUT)) ? period : USB_EVENT_TIMEOUT;
+        tv.tv_sec = 0;
+        tv.tv_usec = timeout * 1000;
+        r = libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+        if ((r < 0) && (r != LIBUSB_ERROR_INTERRUPTED))
+        {
+            printf("USB event handling failed: %s\n", libusb_error_name(r));
+            usleep(USB_EVENT_TIMEOUT * 1000);
+        }
+
+        /* Periodic overrun check, off the reader's path */
+        if ((period > 0) && streaming)
+        {
+            now = std::chrono::steady_clock::now();
+            if (now >= next_status)
+            {
+                usb_fx2_poll_status();
+                next_status = now + std::chrono::milliseconds(period);
+            }
+        }
+    }
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Called by the event thread after it published data or noticed the board
+ * is gone. The reader is only woken once it can do a batch of work, and
+ * the lock is only taken when somebody is actually waiting.
+ */
+void gn3s::usb_fx2_wake(bool always)
+{
+    /* Pairs with the fences in wait() and clear_data_fd(): either we see the waiter, or it sees the data */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (data_fd_armed.load(std::memory_order_relaxed) &&
+        (always || device_lost || (ring->fill() >= data_fd_threshold.load(std::memory_order_relaxed))))
+        signal_data_fd();
+
+    if (data_waiters.load(std::memory_order_relaxed) == 0)
+        return;
+    if (!always && !device_lost && (ring->fill() < data_wanted.load(std::memory_order_relaxed)))
+        return;
+
+    std::lock_guard<std::mutex> lock(data_lock);
+    data_cond.notify_all();
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! Make the data descriptor readable, once until it is cleared again
+void gn3s::signal_data_fd()
+{
+#ifdef __linux__
+    uint64_t one = 1;
+
+    if (data_fd_armed.exchange(false))
+    {
+        if (::write(data_fd, &one, sizeof(one)) != sizeof(one))
+            data_fd_armed = true;
+    }
+#endif
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * A descriptor that polls readable once at least \a threshold bytes are
+ * buffered, or the board was lost and acquire() needs to be called to get
+ * it back. It is signalled from the transfer completion callback, so
+ * poll/select/epoll loops can serve the GN3S next to sockets and other
+ * boards. It stays readable until clear_data_fd() is called, which should
+ * be done after reading. Returns -1 where eventfd is not available.
+ */
+int gn3s::get_data_fd(unsigned long long threshold)
+{
+#ifdef __linux__
+    int fd;
+
+    if (threshold == 0)
+        threshold = 1;
+    data_fd_threshold = threshold;
+    if (data_fd < 0)
+    {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0)
+        {
+            fprintf(stderr, "GN3S could not create an eventfd: %s\n", strerror(errno));
+            return -1;
+        }
+        data_fd = fd;
+    }
+    clear_data_fd();
+#endif
+    return data_fd;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! Rearm the data descriptor; it fires again right away if enough is still buffered
+void gn3s::clear_data_fd()
+{
+#ifdef __linux__
+    uint64_t count;
+
+    if (data_fd < 0)
+        return;
+    if (::read(data_fd, &count, sizeof(count)) < 0)
+        count = 0;
+    data_fd_armed = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (device_lost || (available() >= data_fd_threshold.load(std::memory_order_relaxed)))
+        signal_data_fd();
+#endif
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Block until at least \a bytes can be read, for at most \a timeout ms.
+ * Returns early when the board is lost, so the caller gets to recover it.
+ * Returns whether the bytes are there.
+ */
+bool gn3s::wait(unsigned long long bytes, int timeout)
+{
+    bool ready;
+
+    if (ring == nullptr)
+        return false;
+    if ((ring->fill() >= bytes) || device_lost || (timeout <= 0))
+        return ring->fill() >= bytes;
+
+    std::unique_lock<std::mutex> lock(data_lock);
+    data_wanted.store(bytes, std::memory_order_relaxed);
+    data_waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    ready = data_cond.wait_for(lock, std::chrono::milliseconds(timeout),
+            [this, bytes] { return (ring->fill() >= bytes) || device_lost; });
+    data_waiters.fetch_sub(1);
+
+    return ready && (ring->fill() >= bytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Copy up to \a bytes samples into \a buff. With \a min_bytes set, first
+ * wait up to \a timeout ms for that many to be buffered.
+ */
+int gn3s::read(unsigned char *buff, int bytes, int min_bytes, int timeout)
+{
+    const unsigned char *p;
+    int n = 0;
+    int avail;
+
+    if (min_bytes > 0)
+        wait(min_bytes, timeout);
+
+    /* One span up to the end of the ring, one after the wrap */
+    while (n < bytes)
+    {
+        avail = acquire(&p);
+        if (avail == 0)
+            break;
+        if (avail > bytes - n)
+            avail = bytes - n;
+        memcpy(buff + n, p, avail);
+        ring->consume(avail);
+        n += avail;
     }
     return(n);
 }
@@ -517,6 +1353,11 @@ bool gn3s::usrp_xfer(char VRQ_TYPE, bool start)
   int r;
 
   r = write_cmd(VRQ_TYPE, start, 0, nullptr, 0);
+  if ((r == 0) && (VRQ_TYPE == VRQ_XFER))
+  {
+      xfer_running = start;
+      lag_restart = true;
+  }
 
   return(r == 0);
 }
@@ -0,0 +1,91 @@
+/*!
+ * \file gn3s_fw2cc.cc
+ * \brief Build time generator turning gn3s_firmware.ihx into gn3s_firmware.cc.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+/*
+ * Usage: gn3s_fw2cc firmware.ihx output.cc
+ *
+ * Parses the Intel HEX image with the same code the driver uses for
+ * override files and writes it out as constant segment tables, so the
+ * library carries the firmware already in binary form.
+ */
+
+#include "gn3s_ihex.h"
+#include <stdio.h>
+
+int main(int argc, char **argv)
+{
+	gn3s_fw_image image;
+	std::string error;
+	FILE *out;
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: %s firmware.ihx output.cc\n", argv[0]);
+		return 1;
+	}
+
+	if (!gn3s_ihex_load(argv[1], image, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	out = fopen(argv[2], "w");
+	if (out == nullptr)
+	{
+		perror(argv[2]);
+		return 1;
+	}
+
+	fprintf(out, "/* Generated by gn3s_fw2cc from gn3s_firmware.ihx, do not edit */\n\n");
+	fprintf(out, "#include \"gn3s_ihex.h\"\n\n");
+
+	for (unsigned int i = 0; i < image.size(); i++)
+	{
+		fprintf(out, "static const unsigned char segment%u[%u] = {", i,
+				(unsigned int)image[i].data.size());
+		for (unsigned int j = 0; j < image[i].data.size(); j++)
+			fprintf(out, "%s0x%02x,", (j % 12) ? " " : "\n\t", image[i].data[j]);
+		fprintf(out, "\n};\n\n");
+	}
+
+	fprintf(out, "const gn3s_fw_builtin_segment gn3s_firmware_segments[] = {\n");
+	for (unsigned int i = 0; i < image.size(); i++)
+		fprintf(out, "\t{ 0x%04x, %u, segment%u },\n", image[i].addr,
+				(unsigned int)image[i].data.size(), i);
+	fprintf(out, "};\n\n");
+	fprintf(out, "const int gn3s_firmware_nsegments = %u;\n", (unsigned int)image.size());
+
+	if (fclose(out) != 0)
+	{
+		perror(argv[2]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,243 @@
+/*!
+ * \file gn3s_ihex.cc
+ * \brief Intel HEX firmware images for the GN3S FX2 microcontroller.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_ihex.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+
+#define IHEX_DATA           (0x00)
+#define IHEX_EOF            (0x01)
+#define IHEX_EXT_SEGMENT    (0x02)
+#define IHEX_EXT_LINEAR     (0x04)
+
+static int hex_nibble(char c)
+{
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	return -1;
+}
+
+static bool by_address(const gn3s_fw_segment &a, const gn3s_fw_segment &b)
+{
+	return a.addr < b.addr;
+}
+
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s_ihex_parse(const std::string &text, gn3s_fw_image &image, std::string &error)
+{
+	std::istringstream in(text);
+	std::string line;
+	std::vector<unsigned char> rec;
+	gn3s_fw_image records;
+	unsigned char sum;
+	unsigned int length, addr, type;
+	int hi, lo, lineno = 0;
+	bool eof = false;
+	char msg[128];
+
+	image.clear();
+	while (!eof && std::getline(in, line))
+	{
+		lineno++;
+		while (!line.empty() && ((line[line.size() - 1] == '\r') || (line[line.size() - 1] == ' ')))
+			line.erase(line.size() - 1);
+		if (line.empty())
+			continue;
+
+		/* ':' then pairs of hex digits: length, address (2), type, data, checksum */
+		if ((line[0] != ':') || ((line.size() % 2) != 1) || (line.size() < 11))
+		{
+			snprintf(msg, sizeof(msg), "line %d: not an Intel HEX record", lineno);
+			error = msg;
+			return false;
+		}
+		rec.clear();
+		sum = 0;
+		for (unsigned int i = 1; i < line.size(); i += 2)
+		{
+			hi = hex_nibble(line[i]);
+			lo = hex_nibble(line[i + 1]);
+			if ((hi < 0) || (lo < 0))
+			{
+				snprintf(msg, sizeof(msg), "line %d: invalid hex digit", lineno);
+				error = msg;
+				return false;
+			}
+			rec.push_back((unsigned char)((hi << 4) | lo));
+			sum += rec.back();
+		}
+
+		length = rec[0];
+		addr = (rec[1] << 8) | rec[2];
+		type = rec[3];
+		if (rec.size() != length + 5)
+		{
+			snprintf(msg, sizeof(msg), "line %d: record length mismatch", lineno);
+			error = msg;
+			return false;
+		}
+		if (sum != 0)
+		{
+			snprintf(msg, sizeof(msg), "line %d: checksum failed", lineno);
+			error = msg;
+			return false;
+		}
+
+		switch (type)
+		{
+			case IHEX_DATA:
+				if (addr + length > 0x10000)
+				{
+					snprintf(msg, sizeof(msg), "line %d: data beyond 0xFFFF", lineno);
+					error = msg;
+					return false;
+				}
+				if (length > 0)
+				{
+					gn3s_fw_segment seg;
+					seg.addr = addr;
+					seg.data.assign(rec.begin() + 4, rec.end() - 1);
+					records.push_back(seg);
+				}
+				break;
+
+			case IHEX_EOF:
+				eof = true;
+				break;
+
+			case IHEX_EXT_SEGMENT:
+			case IHEX_EXT_LINEAR:
+				/* The FX2 only has 16-bit addresses */
+				if ((length != 2) || (rec[4] != 0) || (rec[5] != 0))
+				{
+					snprintf(msg, sizeof(msg), "line %d: extended address not supported", lineno);
+					error = msg;
+					return false;
+				}
+				break;
+
+			default:
+				/* Start address records do not matter to the FX2 loader */
+				break;
+		}
+	}
+
+	if (!eof)
+	{
+		error = "missing end of file record";
+		return false;
+	}
+
+	/* Sort, reject overlaps and merge adjacent records */
+	std::stable_sort(records.begin(), records.end(), by_address);
+	for (unsigned int i = 0; i < records.size(); i++)
+	{
+		if (!image.empty())
+		{
+			gn3s_fw_segment &last = image.back();
+			if (records[i].addr < last.addr + last.data.size())
+			{
+				snprintf(msg, sizeof(msg), "overlapping data at 0x%04x", records[i].addr);
+				error = msg;
+				return false;
+			}
+			if (records[i].addr == last.addr + last.data.size())
+			{
+				last.data.insert(last.data.end(), records[i].data.begin(), records[i].data.end());
+				continue;
+			}
+		}
+		image.push_back(records[i]);
+	}
+
+	return true;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s_ihex_load(const char *filename, gn3s_fw_image &image, std::string &error)
+{
+	std::ifstream f(filename);
+	std::stringstream text;
+
+	if (!f)
+	{
+		error = std::string("cannot open ") + filename;
+		return false;
+	}
+	text << f.rdbuf();
+	if (!gn3s_ihex_parse(text.str(), image, error))
+	{
+		error = std::string(filename) + ": " + error;
+		return false;
+	}
+	return true;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Two 64-bit FNV-1a sums with different offset bases, each over the
+ * address, length and bytes of every segment, stored little endian.
+ */
+void gn3s_fw_hash(const gn3s_fw_image &image, unsigned char hash[GN3S_FW_HASH_SIZE])
+{
+	const uint64_t prime = 0x100000001b3ULL;
+	uint64_t h[2] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL };
+	unsigned char head[4];
+
+	for (unsigned int i = 0; i < image.size(); i++)
+	{
+		head[0] = image[i].addr & 0xff;
+		head[1] = (image[i].addr >> 8) & 0xff;
+		head[2] = image[i].data.size() & 0xff;
+		head[3] = (image[i].data.size() >> 8) & 0xff;
+		for (int k = 0; k < 2; k++)
+		{
+			for (int j = 0; j < 4; j++)
+				h[k] = (h[k] ^ head[j]) * prime;
+			for (unsigned int j = 0; j < image[i].data.size(); j++)
+				h[k] = (h[k] ^ image[i].data[j]) * prime;
+		}
+	}
+
+	for (int k = 0; k < 2; k++)
+		for (int j = 0; j < 8; j++)
+			hash[k * 8 + j] = (h[k] >> (8 * j)) & 0xff;
+}
+/*----------------------------------------------------------------------------------------------*/
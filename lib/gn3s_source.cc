@@ -27,16 +27,43 @@
 
 
 #include "gn3s_source.h"
+#include "gn3s_unpack.h"
 #include <time.h>
+#include <chrono>
+#include <algorithm>
 
 
 /*----------------------------------------------------------------------------------------------*/
-gn3s_Source::gn3s_Source()
+gn3s_Source::gn3s_Source(const std::string &_device, int _ntransfers, int _transfer_size, bool _dev_mem,
+		const std::string &_firmware, int _renum_timeout, bool _fill_gaps, int _event_priority,
+		int _status_period)
 {
 
+	device = _device;
+	ntransfers = _ntransfers;
+	transfer_size = _transfer_size;
+	dev_mem = _dev_mem;
+	firmware = _firmware;
+	renum_timeout = _renum_timeout;
+	fill_gaps = _fill_gaps;
+	event_priority = _event_priority;
+	status_period = _status_period;
     Open_GN3S();
 
-	overflw = soverflw = 0;
+	overflw = 0;
+	host_overruns = 0;
+	rx_overruns = 0;
+	rx_ungapped = 0;
+	reconnects = 0;
+	slips = 0;
+	sample_count = 0;
+	timeline_pending = 0;
+	timeline = 0;
+	timeline_sample = 0;
+	timeline_time = 0.0;
+	timeline_lost = 0;
+	lost_pending = 0;
+	gap_left = 0;
 	agc_scale = 1;
 
 	/* Assign to base */
@@ -59,10 +86,10 @@ gn3s_Source::~gn3s_Source()
 
 
 /*----------------------------------------------------------------------------------------------*/
-int gn3s_Source::Read(gn3s_ms_packet *_p,int n_samples)
+int gn3s_Source::Read(void *_p,int n_samples,gn3s_sample_format format)
 {
 
-	int n = Read_GN3S(_p,n_samples);
+	int n = Read_GN3S(_p,n_samples,format);
 	ms_count++;
 	return n;
 
@@ -70,13 +97,114 @@ int gn3s_Source::Read(gn3s_ms_packet *_p,int n_samples)
 /*----------------------------------------------------------------------------------------------*/
 
 
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Tell the board to stream samples. Whatever is still buffered from before
+ * a Stop() is dropped, so the first sample read is a fresh one. Retries
+ * for at most USB_READ_TIMEOUT ms, however long each control request takes.
+ */
+bool gn3s_Source::Start()
+{
+	std::chrono::steady_clock::time_point deadline;
+	bool started = false;
+
+	Flush();
+
+	deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(USB_READ_TIMEOUT);
+	for (;;)
+	{
+		started = gn3s_a->usrp_xfer(VRQ_XFER, 1);
+		if (started || (std::chrono::steady_clock::now() >= deadline))
+			break;
+		usleep(100);
+	}
+	if (!started)
+		return false;
+
+	fprintf(stdout,"started TX\n");
+	flag_first_read=false;
+	timeline_pending |= GN3S_TIMELINE_START;
+	return true;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Non-zero if the samples of the last Read() follow a start or a loss of
+ * samples. Then *\a sample is the first of them, counted as by
+ * getSampleCount(), and *\a time when it was taken by the host clock.
+ * *\a lost is how many samples are known to be missing before it, 0 if
+ * that is not known; with fill_gaps the sample is the first of the zeros
+ * written in their place.
+ */
+int gn3s_Source::getTimeline(unsigned long long *sample, double *time, unsigned long long *lost)
+{
+
+	*sample = timeline_sample;
+	*time = timeline_time;
+	*lost = timeline_lost;
+	return timeline;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Empty the host ring. The FX2 firmware has no request to clear its own
+ * FIFO, which holds a few packets at most. The next sample starts a new
+ * timeline.
+ */
+void gn3s_Source::Flush()
+{
+	const unsigned char *span;
+	int avail;
+
+	while ((avail = gn3s_a->acquire(&span)) > 0)
+		gn3s_a->release(avail);
+	iq.reset();
+	gap_left = 0;
+	lost_pending = 0;
+	timeline_pending |= GN3S_TIMELINE_START;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_Source::getStats(gn3s_stats *stats)
+{
+	unsigned long long size = gn3s_a->capacity();
+
+	stats->samples = sample_count;
+	stats->transfer_errors = gn3s_a->transfer_errors();
+	stats->rx_overruns = gn3s_a->rx_overruns();
+	stats->host_overruns = gn3s_a->host_overruns();
+	stats->lost_samples = gn3s_a->lost_bytes() / 2;
+	stats->reconnects = gn3s_a->reconnects();
+	stats->slips = iq.get_slips();
+	stats->ring_fill = (size > 0) ? (double)gn3s_a->available() / size : 0.0;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+bool gn3s_Source::Stop()
+{
+
+	flag_first_read=true;
+	return gn3s_a->usrp_xfer(VRQ_XFER, 0);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
 /*----------------------------------------------------------------------------------------------*/
 void gn3s_Source::Open_GN3S()
 {
 
 
 	/* Create the object */
-	gn3s_a = new gn3s(0);
+	gn3s_a = new gn3s(device, ntransfers, transfer_size, dev_mem, event_priority, firmware, renum_timeout);
+	gn3s_a->set_overrun_poll(status_period);
 
 
 	/* Everything is super! */
@@ -99,91 +227,143 @@ void gn3s_Source::Close_GN3S()
 
 
 /*----------------------------------------------------------------------------------------------*/
-int gn3s_Source::Read_GN3S(gn3s_ms_packet *_p,int n_samples)
+int gn3s_Source::Read_GN3S(void *_p,int n_samples,gn3s_sample_format format)
 {
 
-    int bread;
-	int started=0;
-	int check;
-	bool overrun;
+	int avail, used, n, nsamp, batch;
+	const unsigned char *span;
+	double first_time;
+	unsigned long long gap;
+
+	/* Not started by the block, or the board did not answer then */
+	if (flag_first_read==true)
+		Start();
+
+	/* Check the overrun, as last polled by the USB event thread; what it
+	   lost is estimated and tagged where it is missing, as a gap below,
+	   and overruns with no estimate are tagged here */
+	if(gn3s_a->rx_overruns_ungapped() != rx_ungapped)
+	{
+		rx_ungapped = gn3s_a->rx_overruns_ungapped();
+		timeline_pending |= GN3S_TIMELINE_OVERFLOW;
+	}
+	if(gn3s_a->rx_overruns() != rx_overruns)
+	{
+		rx_overruns = gn3s_a->rx_overruns();
+		overflw++;
+		time(&rawtime);
+		timeinfo = localtime (&rawtime);
+		fprintf(stdout, "GN3S overflow at time %s\n", asctime(timeinfo));
+		fflush(stdout);
+	}
+
+	/* Check whether the USB thread had to drop data we did not read in time;
+	   where the data is missing shows up as a gap below */
+	if(gn3s_a->host_overruns() != host_overruns)
+	{
+		host_overruns = gn3s_a->host_overruns();
+		overflw++;
+		time(&rawtime);
+		timeinfo = localtime (&rawtime);
+		fprintf(stdout, "GN3S host buffer overflow (%llu transfers dropped) at time %s\n",
+				host_overruns, asctime(timeinfo));
+		fflush(stdout);
+	}
+
+	/* Samples were lost while the board was unplugged */
+	if(gn3s_a->reconnects() != reconnects)
+	{
+		reconnects = gn3s_a->reconnects();
+		timeline_pending |= GN3S_TIMELINE_OVERFLOW;
+		iq.reset();
+		time(&rawtime);
+		timeinfo = localtime (&rawtime);
+		fprintf(stdout, "GN3S reconnected, gap in the sample stream at time %s\n",
+				asctime(timeinfo));
+		fflush(stdout);
+	}
 
-	short int LUT4120[2] = {1,-1};
-	char shift = 0;
-	char endshift = 0;
+	/* Sleep until a transfer's worth is buffered rather than return nothing */
+	batch = gn3s_a->get_transfer_size() / 2;
+	if (batch > n_samples)
+		batch = n_samples;
+	gn3s_a->wait(2 * batch, USB_READ_TIMEOUT);
 
-	short int *pbuff;
+	/* The oldest buffered byte is the next sample; it was taken that long ago */
+	first_time = std::chrono::duration<double>(
+			std::chrono::system_clock::now().time_since_epoch()).count() -
+			(double)(gn3s_a->available() / 2) / GN3S_SAMPLE_RATE;
 
-	int BUFSIZE=n_samples*2;
+	nsamp = 0;
 
-    if (flag_first_read==true)
+	/* Unpack straight out of the USB transfer memory into the caller's buffer */
+	while (nsamp < n_samples)
 	{
-		/* Start transfer */
-        while(!started)
+		/* Zeros in place of lost samples keep the output on the sample clock */
+		if (gap_left > 0)
 		{
-            usleep(100);
-			started = gn3s_a->usrp_xfer(VRQ_XFER, 1);
-        }
-		fprintf(stdout,"started TX\n");
-		flag_first_read=false;
+			n = (int)std::min(gap_left, (unsigned long long)(n_samples - nsamp));
+			memset((char *)_p + gn3s_sample_bytes(format, nsamp), 0, gn3s_sample_bytes(format, n));
+			nsamp += n;
+			gap_left -= n;
+			continue;
+		}
+
+		/* Samples missing before the next byte start a Read of their own, to be tagged */
+		gap = gn3s_a->gap();
+		if (gap > 0)
+		{
+			if (nsamp > 0)
+				break;
+			gn3s_a->take_gap();
+			iq.reset();
+			lost_pending += (gap + 1) / 2;
+			timeline_pending |= GN3S_TIMELINE_OVERFLOW;
+			if (fill_gaps && (format != GN3S_PACKED) && (format != GN3S_RAW))
+			{
+				gap_left = (gap + 1) / 2;
+				first_time -= (double)gap_left / GN3S_SAMPLE_RATE;
+			}
+			time(&rawtime);
+			timeinfo = localtime (&rawtime);
+			fprintf(stdout, "GN3S lost %llu samples%s at time %s\n", (gap + 1) / 2,
+					(gap_left > 0) ? ", filled with zeros" : "", asctime(timeinfo));
+			fflush(stdout);
+			continue;
+		}
+
+		avail = gn3s_a->acquire(&span);
+		if (avail == 0)
+			break;
+		used = iq.unpack(span, avail, (char *)_p + gn3s_sample_bytes(format, nsamp), format,
+				n_samples - nsamp, &n);
+		gn3s_a->release(used);
+		nsamp += n;
 	}
 
-	/* Check the overrun */
-	overrun = gn3s_a->check_rx_overrun();
-	if(overrun)
+	/* The tracker had to drop bytes to get back in step */
+	if(iq.get_slips() != slips)
 	{
+		slips = iq.get_slips();
 		time(&rawtime);
 		timeinfo = localtime (&rawtime);
-		fprintf(stdout, "GN3S overflow at time %s\n", asctime(timeinfo));
+		fprintf(stdout, "GN3S I/Q phase slip (%llu so far) at time %s\n",
+				slips, asctime(timeinfo));
 		fflush(stdout);
 	}
 
+	/* Attach what happened since the last samples to the first of these */
+	timeline = 0;
+	if ((nsamp > 0) && (timeline_pending != 0))
+	{
+		timeline = timeline_pending;
+		timeline_pending = 0;
+		timeline_sample = sample_count;
+		timeline_time = first_time;
+		timeline_lost = lost_pending;
+		lost_pending = 0;
+	}
+	sample_count += nsamp;
 
-		/* Read 5 ms */
-        bread = gn3s_a->read(gbuff, BUFSIZE);
-		// FUSB Read...
-		//ret = fx2c.d_ephandle->read (buf, bufsize);
-
-//		if (bread != BUFSIZE) {
-//		  fprintf (stderr, "fusb_read: ret = %d (bufsize: %d) \n", bread, BUFSIZE);
-//          fprintf (stderr, "%s\n", libusb_error_name());
-//		}
-
-		// Store IF data as 8bit signed values
-	   pbuff = (short int *)&buff[0];
-	/* Make sure we are reading I0,Q0,I1,Q1,I2,Q2.... etc */
-	   if ((gbuff[0] & 0x2) == 2)       //if true, we don't have to shift data
-	   { shift = 0; }
-	   else
-	   { shift = 1; }
-
-	   if ((gbuff[bread-1] & 0x02) == 0) //if true, we don't drop last data byte
-	   { endshift = 0; }
-	   else
-	   { endshift = 1; }
-
-	       for (int j=0;j<bread;j++)
-	       {
-	           if (shift == 1)
-	           {
-	               if ((j == (bread-1)) && (endshift == 0))
-	                 { pbuff[j] = 0; }
-	               else if ((j == (bread-1)) && (endshift == 1))
-	                 { pbuff[j-1] = 0;  }
-	               else
-	               {
-	            	   //printf("%i.",j);
-	            	   pbuff[j] = LUT4120[gbuff[j+1] & 0x1];
-	               }
-	           } else if (shift == 0)
-	           {
-	               if ((j == (bread-1)) && (endshift == 1))
-	                 { pbuff[j] = 0; }
-	               else
-	               { pbuff[j] = LUT4120[gbuff[j] & 0x1]; }
-
-	           }
-	       }
-	/* Copy to destination */
-	memcpy(_p->data, pbuff, n_samples*sizeof(GN3S_CPX));
-	return (bread / 2);
+	return (nsamp);
 }
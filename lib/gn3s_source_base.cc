@@ -0,0 +1,242 @@
+/*!
+ * \file gn3s_source_base.cc
+ * \brief Common part of the GN3S source blocks, one per output item type.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2012  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gn3s_source.h>
+#include <gn3s_source_base.h>
+#include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include <math.h>
+#include <stdexcept>
+
+static const int MIN_IN = 0;	// mininum number of input streams
+static const int MAX_IN = 0;	// maximum number of input streams
+static const int MIN_OUT = 1;	// minimum number of output streams
+static const int MAX_OUT = 1;	// maximum number of output streams
+static const int OUT_TRANSFERS = 4;	// USB transfers the output buffer holds at least
+
+// UHD style stream tags
+static const pmt::pmt_t RX_TIME = pmt::string_to_symbol("rx_time");
+static const pmt::pmt_t RX_RATE = pmt::string_to_symbol("rx_rate");
+static const pmt::pmt_t RX_OVERFLOW = pmt::string_to_symbol("rx_overflow");
+static const pmt::pmt_t RX_GAP = pmt::string_to_symbol("rx_gap");	// I/Q pairs lost
+
+static const pmt::pmt_t COMMAND_PORT = pmt::mp("command");
+static const pmt::pmt_t STATS_PORT = pmt::mp("stats");
+static const int STATS_INTERVAL = 1000;	// default ms between stats messages
+
+gn3s_source_base::gn3s_source_base (const std::string &name, size_t itemsize, int _format,
+                                    int _items_per_sample, int _samples_per_item,
+                                    const std::string &device,
+                                    int num_transfers, int transfer_size, bool dev_mem,
+                                    const std::string &firmware, int renum_timeout,
+                                    bool fill_gaps, int event_priority, int status_period)
+  : gr::sync_block (name,
+	      gr::io_signature::make(MIN_IN, MAX_IN, 0),
+	      gr::io_signature::make(MIN_OUT, MAX_OUT, itemsize)),
+    format (_format), items_per_sample (_items_per_sample),
+    samples_per_item (_samples_per_item), paused (false),
+    stats_interval (STATS_INTERVAL), stats_samples (0)
+{
+  if (transfer_size <= 0)
+    throw std::invalid_argument("gn3s_source: transfer_size must be positive");
+
+  /* Create the GN3S object*/
+  gn3s_drv = new gn3s_Source(device, num_transfers, transfer_size, dev_mem, firmware,
+                             renum_timeout, fill_gaps, event_priority, status_period);
+
+  // Work on whole transfers, as rounded to USB packets by the driver;
+  // that is also a whole number of I/Q pairs and of packed bytes
+  int transfer_items = gn3s_drv->getTransferSize() / 2 * items_per_sample / samples_per_item;
+  set_output_multiple(transfer_items);
+  set_min_output_buffer(OUT_TRANSFERS * transfer_items);
+
+  message_port_register_in(COMMAND_PORT);
+  set_msg_handler(COMMAND_PORT, boost::bind(&gn3s_source_base::handle_command, this, _1));
+  message_port_register_out(STATS_PORT);
+  stats_time = std::chrono::steady_clock::now();
+
+  fprintf(stdout,"GN3S Start\n");
+}
+
+gn3s_source_base::~gn3s_source_base ()
+{
+    if(gn3s_drv != nullptr)
+	{
+		fprintf(stdout,"Destructing GN3S\n");
+		delete gn3s_drv;
+	}
+}
+
+bool
+gn3s_source_base::start ()
+{
+  // If the board does not answer now, the first read tries again
+  paused = false;
+  gn3s_drv->Start();
+  return true;
+}
+
+bool
+gn3s_source_base::stop ()
+{
+  gn3s_drv->Stop();
+  return true;
+}
+
+void
+gn3s_source_base::set_stats_interval (int ms)
+{
+  stats_interval = (ms > 0) ? ms : 0;
+}
+
+// Messages are handled by the block's thread between calls to work(),
+// so the driver is never used from two threads at once
+void
+gn3s_source_base::handle_command (pmt::pmt_t msg)
+{
+  pmt::pmt_t keys;
+
+  if (pmt::is_symbol(msg))
+    do_command(pmt::symbol_to_string(msg), pmt::PMT_NIL);
+  else if (pmt::is_pair(msg) && pmt::is_symbol(pmt::car(msg)))
+    do_command(pmt::symbol_to_string(pmt::car(msg)), pmt::cdr(msg));
+  else if (pmt::is_dict(msg))
+    {
+      keys = pmt::dict_keys(msg);
+      for (size_t i = 0; i < pmt::length(keys); i++)
+        do_command(pmt::symbol_to_string(pmt::nth(i, keys)),
+                   pmt::dict_ref(msg, pmt::nth(i, keys), pmt::PMT_NIL));
+    }
+  else
+    fprintf(stdout, "GN3S: ignoring command message %s\n", pmt::write_string(msg).c_str());
+}
+
+void
+gn3s_source_base::do_command (const std::string &cmd, pmt::pmt_t value)
+{
+  if (cmd == "start")
+    {
+      paused = false;
+      gn3s_drv->Start();
+    }
+  else if (cmd == "stop")
+    {
+      paused = true;
+      gn3s_drv->Stop();
+    }
+  else if (cmd == "reset_fifo")
+    gn3s_drv->Flush();
+  else if ((cmd == "stats_interval") && pmt::is_integer(value))
+    set_stats_interval(pmt::to_long(value));
+  else
+    // The SiGe front end has no settings the firmware can change
+    fprintf(stdout, "GN3S: command %s is not supported\n", cmd.c_str());
+}
+
+void
+gn3s_source_base::publish_stats ()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double dt = std::chrono::duration<double>(now - stats_time).count();
+  pmt::pmt_t d;
+  gn3s_stats s;
+
+  if ((stats_interval == 0) || (dt * 1000.0 < stats_interval))
+    return;
+
+  gn3s_drv->getStats(&s);
+  d = pmt::make_dict();
+  d = pmt::dict_add(d, pmt::mp("samples"), pmt::from_uint64(s.samples));
+  d = pmt::dict_add(d, pmt::mp("throughput"),
+                    pmt::from_double((dt > 0.0) ? (s.samples - stats_samples) / dt : 0.0));
+  d = pmt::dict_add(d, pmt::mp("transfer_errors"), pmt::from_uint64(s.transfer_errors));
+  d = pmt::dict_add(d, pmt::mp("rx_overruns"), pmt::from_uint64(s.rx_overruns));
+  d = pmt::dict_add(d, pmt::mp("host_overruns"), pmt::from_uint64(s.host_overruns));
+  d = pmt::dict_add(d, pmt::mp("lost_samples"), pmt::from_uint64(s.lost_samples));
+  d = pmt::dict_add(d, pmt::mp("reconnects"), pmt::from_uint64(s.reconnects));
+  d = pmt::dict_add(d, pmt::mp("slips"), pmt::from_uint64(s.slips));
+  d = pmt::dict_add(d, pmt::mp("ring_fill"), pmt::from_double(s.ring_fill));
+  message_port_pub(STATS_PORT, d);
+
+  stats_time = now;
+  stats_samples = s.samples;
+}
+
+int
+gn3s_source_base::work (int noutput_items,
+		       gr_vector_const_void_star &input_items,
+		       gr_vector_void_star &output_items)
+{
+  uint64_t offset = nitems_written(0);
+  unsigned long long first, lost;
+  double t, secs;
+  int n_samples_rx, timeline;
+
+  // Stopped by a command: nothing to read, but keep reporting
+  if (paused)
+    {
+      usleep(USB_READ_TIMEOUT * 1000);
+      publish_stats();
+      return 0;
+    }
+
+  // Samples go from the USB transfer memory straight into the output
+  // buffer, as many as fit
+  n_samples_rx = gn3s_drv->Read(output_items[0],
+                                noutput_items / items_per_sample * samples_per_item,
+                                (gn3s_sample_format) format);
+
+  // Tag the first item after a start or a loss of samples, so downstream
+  // can tell where it is on the sample clock. rx_rate is in output
+  // items, so item offsets convert to time whatever the item type;
+  // rx_gap stays in I/Q pairs.
+  timeline = gn3s_drv->getTimeline(&first, &t, &lost);
+  if (timeline != 0)
+    {
+      secs = floor(t);
+      add_item_tag(0, offset, RX_TIME,
+                   pmt::make_tuple(pmt::from_uint64((uint64_t) secs), pmt::from_double(t - secs)),
+                   alias_pmt());
+      add_item_tag(0, offset, RX_RATE,
+                   pmt::from_double(GN3S_SAMPLE_RATE * items_per_sample / samples_per_item),
+                   alias_pmt());
+      if (timeline & GN3S_TIMELINE_OVERFLOW)
+        add_item_tag(0, offset, RX_OVERFLOW, pmt::PMT_T, alias_pmt());
+      if (lost > 0)
+        add_item_tag(0, offset, RX_GAP, pmt::from_uint64(lost), alias_pmt());
+    }
+
+  publish_stats();
+
+  // Tell runtime system how many output items we produced.
+  return n_samples_rx * items_per_sample / samples_per_item;
+}
@@ -31,89 +31,32 @@
 #include "config.h"
 #endif
 
-#include <gn3s_source.h>
 #include <gn3s_source_cc.h>
-#include <gn3s_defines.h>
-#include <gnuradio/io_signature.h>
-
-  /* Create the GN3S object*/
-static gn3s_Source *gn3s_drv;
-static gn3s_ms_packet packet;
+#include <gn3s_unpack.h>
+#include <gnuradio/gr_complex.h>
 
 /*
  * Create a new instance of howto_square_ff and return
  * a boost shared_ptr.  This is effectively the public constructor.
  */
 gn3s_source_cc_sptr
-gn3s_make_source_cc ()
+gn3s_make_source_cc (const std::string &device, int num_transfers, int transfer_size, bool dev_mem,
+                     const std::string &firmware, int renum_timeout, bool fill_gaps,
+                     int event_priority, int status_period)
 {
-  return gnuradio::get_initial_sptr(new gn3s_source_cc ());
+  return gnuradio::get_initial_sptr(new gn3s_source_cc (device, num_transfers, transfer_size, dev_mem,
+                                                        firmware, renum_timeout, fill_gaps,
+                                                        event_priority, status_period));
 }
 
-/*
- * Specify constraints on number of input and output streams.
- * This info is used to construct the input and output signatures
- * (2nd & 3rd args to gr::block's constructor).  The input and
- * output signatures are used by the runtime system to
- * check that a valid number and type of inputs and outputs
- * are connected to this block.  In this case, we accept
- * only 1 input and 1 output.
- */
-static const int MIN_IN = 0;	// mininum number of input streams
-static const int MAX_IN = 0;	// maximum number of input streams
-static const int MIN_OUT = 1;	// minimum number of output streams
-static const int MAX_OUT = 1;	// maximum number of output streams
-
 /*
  * The private constructor
  */
-gn3s_source_cc::gn3s_source_cc ()
-  : gr::block ("gn3s_cc",
-	      gr::io_signature::make(MIN_IN, MAX_IN, sizeof (gr_complex)),
-	      gr::io_signature::make(MIN_OUT, MAX_OUT, sizeof (gr_complex)))
-{
-  // constructor code here
-  gn3s_drv = new gn3s_Source();
-  fprintf(stdout,"GN3S Start\n");
-}
-
-/*
- * Our virtual destructor.
- */
-gn3s_source_cc::~gn3s_source_cc ()
+gn3s_source_cc::gn3s_source_cc (const std::string &device, int num_transfers, int transfer_size,
+                                bool dev_mem, const std::string &firmware,
+                                int renum_timeout, bool fill_gaps, int event_priority, int status_period)
+  : gn3s_source_base ("gn3s_cc", sizeof (gr_complex), GN3S_FLOAT, 1, 1,
+                      device, num_transfers, transfer_size, dev_mem, firmware, renum_timeout,
+                      fill_gaps, event_priority, status_period)
 {
-  // destructor code here
-    if(gn3s_drv != nullptr)
-	{
-		fprintf(stdout,"Destructing GN3S\n");
-		delete gn3s_drv;
-		//delete packet;
-	}
 }
-
-int 
-gn3s_source_cc::general_work (int noutput_items,
-			       gr_vector_int &ninput_items,
-			       gr_vector_const_void_star &input_items,
-			       gr_vector_void_star &output_items)
-{
-int n_samples_rx;
-  gr_complex *out = (gr_complex *) output_items[0];
-  
-if (noutput_items<=GN3S_SAMPS_5MS)
-{
-  n_samples_rx = gn3s_drv->Read(&packet,noutput_items);
-}
-else
-{
-  n_samples_rx = gn3s_drv->Read(&packet,GN3S_SAMPS_5MS);
-}
-  for (int i = 0; i < n_samples_rx; i++)
-  {
-	out[i] = gr_complex(packet.data[i].i, packet.data[i].q);
-  }
-
-  // Tell runtime system how many output items we produced.
-  return n_samples_rx;
-}
-
@@ -0,0 +1,61 @@
+/*!
+ * \file gn3s_source_cs.cc
+ * \brief GNU Radio source block for the SiGe GN3S USB sampler v2, complex int16.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2012  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gn3s_source_cs.h>
+#include <gn3s_unpack.h>
+#include <stdint.h>
+
+/*
+ * Create a new instance of gn3s_source_cs and return
+ * a boost shared_ptr.  This is effectively the public constructor.
+ */
+gn3s_source_cs_sptr
+gn3s_make_source_cs (const std::string &device, int num_transfers, int transfer_size, bool dev_mem,
+                     const std::string &firmware, int renum_timeout, bool fill_gaps,
+                     int event_priority, int status_period)
+{
+  return gnuradio::get_initial_sptr(new gn3s_source_cs (device, num_transfers, transfer_size, dev_mem,
+                                                        firmware, renum_timeout, fill_gaps,
+                                                        event_priority, status_period));
+}
+
+/*
+ * The private constructor
+ */
+gn3s_source_cs::gn3s_source_cs (const std::string &device, int num_transfers, int transfer_size,
+                                bool dev_mem, const std::string &firmware,
+                                int renum_timeout, bool fill_gaps, int event_priority, int status_period)
+  : gn3s_source_base ("gn3s_cs", 2 * sizeof (int16_t), GN3S_INT16, 1, 1,
+                      device, num_transfers, transfer_size, dev_mem, firmware, renum_timeout,
+                      fill_gaps, event_priority, status_period)
+{
+}
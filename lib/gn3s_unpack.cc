@@ -0,0 +1,266 @@
+/*!
+ * \file gn3s_unpack.cc
+ * \brief Portable unpack kernel and runtime selection of the SIMD ones.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_unpack.h"
+#include <string.h>
+#include <algorithm>
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack_generic(const unsigned char *in, float *out, int nbytes)
+{
+	gn3s_unpack_ref(in, out, nbytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack16_generic(const unsigned char *in, int16_t *out, int nbytes)
+{
+	gn3s_unpack_ref(in, out, nbytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack8_generic(const unsigned char *in, int8_t *out, int nbytes)
+{
+	gn3s_unpack_ref(in, out, nbytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_pack_generic(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	gn3s_pack_ref<0>(in, out, nbytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! Unpack \a nbytes at \a in into \a out, whose element type \a format gives
+static void unpack_as(const gn3s_unpack_kernel &k, gn3s_sample_format format,
+		const unsigned char *in, void *out, int nbytes)
+{
+	switch (format)
+	{
+		case GN3S_INT16:
+			k.fn16(in, (int16_t *)out, nbytes);
+			break;
+		case GN3S_INT8:
+			k.fn8(in, (int8_t *)out, nbytes);
+			break;
+		case GN3S_RAW:
+			memcpy(out, in, nbytes);
+			break;
+		default:
+			k.fn(in, (float *)out, nbytes);
+			break;
+	}
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+int gn3s_check_generic(const unsigned char *in, int nbytes)
+{
+	int i;
+
+	for (i = 0; i + 1 < nbytes; i += 2)
+	{
+		if (((in[i] & GN3S_I_MARKER) == 0) || ((in[i + 1] & GN3S_I_MARKER) != 0))
+			break;
+	}
+	return i;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * The GN3S_HAVE_* macros say which kernels the build compiled, each in its
+ * own file with its own instruction set flags; the CPU is asked at run
+ * time which of them it can execute.
+ */
+std::vector<gn3s_unpack_kernel> gn3s_unpack_kernels()
+{
+	std::vector<gn3s_unpack_kernel> kernels;
+
+	kernels.push_back({"generic", gn3s_unpack_generic, gn3s_unpack16_generic, gn3s_unpack8_generic,
+			gn3s_pack_generic, gn3s_check_generic});
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+#ifdef GN3S_HAVE_SSE2
+	if (__builtin_cpu_supports("sse2"))
+		kernels.push_back({"sse2", gn3s_unpack_sse2, gn3s_unpack16_sse2, gn3s_unpack8_sse2,
+				gn3s_pack_sse2, gn3s_check_sse2});
+#endif
+#ifdef GN3S_HAVE_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back({"avx2", gn3s_unpack_avx2, gn3s_unpack16_avx2, gn3s_unpack8_avx2,
+				gn3s_pack_avx2, gn3s_check_avx2});
+#endif
+#ifdef GN3S_HAVE_AVX512BW
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		kernels.push_back({"avx512bw", gn3s_unpack_avx512bw, gn3s_unpack16_avx512bw,
+				gn3s_unpack8_avx512bw, gn3s_pack_avx512bw, gn3s_check_avx512bw});
+#endif
+#endif
+
+#ifdef GN3S_HAVE_NEON
+	/* Only built where NEON is part of the baseline */
+	kernels.push_back({"neon", gn3s_unpack_neon, gn3s_unpack16_neon, gn3s_unpack8_neon,
+			gn3s_pack_neon, gn3s_check_neon});
+#endif
+
+	return kernels;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+const gn3s_unpack_kernel &gn3s_unpack_best()
+{
+	static const gn3s_unpack_kernel best = gn3s_unpack_kernels().back();
+
+	return best;
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_iq_tracker::put(const gn3s_unpack_kernel &k, gn3s_sample_format format,
+		const unsigned char *in, int nbytes, void *out, int n)
+{
+	static const gn3s_pack_fn finish[4] = { gn3s_pack_ref<0>, gn3s_pack_ref<1>,
+		gn3s_pack_ref<2>, gn3s_pack_ref<3> };
+	uint8_t *o = (uint8_t *)out;
+	int head;
+
+	if (format != GN3S_PACKED)
+	{
+		unpack_as(k, format, in, (char *)out + gn3s_sample_bytes(format, n), nbytes);
+		return;
+	}
+
+	/* Finish a byte already started with the reference kernel for its phase */
+	if (n % 4 != 0)
+	{
+		head = std::min(nbytes, 8 - 2 * (n % 4));
+		finish[n % 4](in, o + n / 4, head);
+		in += head;
+		nbytes -= head;
+		n += head / 2;
+	}
+	k.pack(in, o + n / 4, nbytes);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+int gn3s_iq_tracker::unpack(const unsigned char *in, int nbytes, void *out, gn3s_sample_format format,
+		int max_samples, int *nsamp)
+{
+	const gn3s_unpack_kernel &k = gn3s_unpack_best();
+	uint8_t *o = (uint8_t *)out;
+	unsigned char pair[2];
+	int pos = 0, n = 0;
+	int len, good;
+
+	/* Pairs left short of a byte last time lead the output */
+	if (format == GN3S_PACKED)
+	{
+		max_samples &= ~3;
+		if (max_samples > 0)
+		{
+			o[0] = pend_bits;
+			n = pend_n;
+		}
+	}
+
+	/* The I byte left over from the last piece pairs with the first byte of this one */
+	if (have_i && (nbytes > 0) && (max_samples > 0))
+	{
+		have_i = false;
+		if ((in[0] & GN3S_I_MARKER) == 0)
+		{
+			pair[0] = i_byte;
+			pair[1] = in[0];
+			put(k, format, pair, 2, out, n);
+			n++;
+			pos = 1;
+		}
+		else
+			slip();
+	}
+
+	/* Check a block, unpack the part that is in phase, drop a byte where it is not */
+	while ((n < max_samples) && (nbytes - pos >= 2))
+	{
+		len = std::min(2 * (max_samples - n), (nbytes - pos) & ~1);
+		len = std::min(len, GN3S_TRACK_BLOCK);
+		good = k.check(in + pos, len);
+		put(k, format, in + pos, good, out, n);
+		pos += good;
+		n += good / 2;
+		if (good > 0)
+			locked = true;
+		if (good < len)
+		{
+			slip();
+			pos++;
+		}
+	}
+
+	/* A lone I byte waits for the next piece, a lone Q byte is of no use */
+	if ((n < max_samples) && (nbytes - pos == 1))
+	{
+		if (in[pos] & GN3S_I_MARKER)
+		{
+			have_i = true;
+			i_byte = in[pos];
+		}
+		else
+			slip();
+		pos++;
+	}
+
+	/* Keep the pairs of an incomplete byte back */
+	if ((format == GN3S_PACKED) && (max_samples > 0))
+	{
+		pend_n = n % 4;
+		pend_bits = pend_n ? o[n / 4] : 0;
+		n -= pend_n;
+	}
+
+	*nsamp = n;
+	return pos;
+}
+/*----------------------------------------------------------------------------------------------*/
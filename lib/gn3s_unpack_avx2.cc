@@ -0,0 +1,133 @@
+/*!
+ * \file gn3s_unpack_avx2.cc
+ * \brief AVX2 unpack kernel, built with -mavx2.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_unpack.h"
+#include <immintrin.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------------------------*/
+//! As the SSE2 kernel, with vpmovzxbd doing the widening eight bytes at a time
+void gn3s_unpack_avx2(const unsigned char *in, float *out, int nbytes)
+{
+	const __m256i one = _mm256_set1_epi32(0x3f800000);
+	__m256i v;
+	int i, j;
+
+	for (i = 0; i + 32 <= nbytes; i += 32)
+	{
+		for (j = 0; j < 32; j += 8)
+		{
+			v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + j)));
+			_mm256_storeu_si256((__m256i *)(out + i + j),
+					_mm256_or_si256(_mm256_slli_epi32(v, 31), one));
+		}
+	}
+
+	gn3s_unpack_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+int gn3s_check_avx2(const unsigned char *in, int nbytes)
+{
+	const __m256i marker = _mm256_set1_epi8(GN3S_I_MARKER);
+	const __m256i iq = _mm256_set1_epi16(GN3S_I_MARKER);
+	__m256i v;
+	unsigned int m;
+	int i;
+
+	for (i = 0; i + 32 <= nbytes; i += 32)
+	{
+		v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(in + i)), marker);
+		m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, iq));
+		if (m != 0xffffffffu)
+			return i + (__builtin_ctz(~m) & ~1);
+	}
+
+	return i + gn3s_check_generic(in + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack8_avx2(const unsigned char *in, int8_t *out, int nbytes)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i v;
+	int i;
+
+	for (i = 0; i + 32 <= nbytes; i += 32)
+	{
+		v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(in + i)), one);
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(_mm256_sub_epi8(zero, v), one));
+	}
+
+	gn3s_unpack8_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! Sign bits shifted to bit 15 and back with an arithmetic shift give 0 or -1
+void gn3s_unpack16_avx2(const unsigned char *in, int16_t *out, int nbytes)
+{
+	const __m256i one = _mm256_set1_epi16(1);
+	__m256i v;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + i)));
+		v = _mm256_srai_epi16(_mm256_slli_epi16(v, 15), 15);
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(v, one));
+	}
+
+	gn3s_unpack16_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! As gn3s_pack_sse2, 32 bytes to 32 bits at a time
+void gn3s_pack_avx2(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	uint32_t m;
+	int i;
+
+	for (i = 0; i + 32 <= nbytes; i += 32)
+	{
+		m = _mm256_movemask_epi8(_mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)(in + i)), 7));
+		memcpy(out + i / 8, &m, sizeof(m));
+	}
+
+	gn3s_pack_generic(in + i, out + i / 8, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
@@ -0,0 +1,143 @@
+/*!
+ * \file gn3s_unpack_avx512.cc
+ * \brief AVX-512BW unpack kernel, built with -mavx512f -mavx512bw.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_unpack.h"
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * One vptestmb gives the sign bits of 64 bytes as a mask; each 16-bit
+ * piece of it then blends +1.0f and -1.0f for 16 outputs.
+ */
+void gn3s_unpack_avx512bw(const unsigned char *in, float *out, int nbytes)
+{
+	const __m512i bit0 = _mm512_set1_epi8(1);
+	const __m512 plus = _mm512_set1_ps(1.0f);
+	const __m512 minus = _mm512_set1_ps(-1.0f);
+	uint64_t m;
+	int i;
+
+	for (i = 0; i + 64 <= nbytes; i += 64)
+	{
+		m = _mm512_test_epi8_mask(_mm512_loadu_si512((const void *)(in + i)), bit0);
+		_mm512_storeu_ps(out + i,      _mm512_mask_blend_ps((__mmask16)(m), plus, minus));
+		_mm512_storeu_ps(out + i + 16, _mm512_mask_blend_ps((__mmask16)(m >> 16), plus, minus));
+		_mm512_storeu_ps(out + i + 32, _mm512_mask_blend_ps((__mmask16)(m >> 32), plus, minus));
+		_mm512_storeu_ps(out + i + 48, _mm512_mask_blend_ps((__mmask16)(m >> 48), plus, minus));
+	}
+
+	gn3s_unpack_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+int gn3s_check_avx512bw(const unsigned char *in, int nbytes)
+{
+	const __m512i marker = _mm512_set1_epi8(GN3S_I_MARKER);
+	const __m512i iq = _mm512_set1_epi16(GN3S_I_MARKER);
+	__m512i v;
+	uint64_t m;
+	int i;
+
+	for (i = 0; i + 64 <= nbytes; i += 64)
+	{
+		v = _mm512_and_si512(_mm512_loadu_si512((const void *)(in + i)), marker);
+		m = _mm512_cmpneq_epi8_mask(v, iq);
+		if (m != 0)
+			return i + (__builtin_ctzll(m) & ~1);
+	}
+
+	return i + gn3s_check_generic(in + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack8_avx512bw(const unsigned char *in, int8_t *out, int nbytes)
+{
+	const __m512i bit0 = _mm512_set1_epi8(1);
+	const __m512i plus = _mm512_set1_epi8(1);
+	const __m512i minus = _mm512_set1_epi8(-1);
+	__mmask64 m;
+	int i;
+
+	for (i = 0; i + 64 <= nbytes; i += 64)
+	{
+		m = _mm512_test_epi8_mask(_mm512_loadu_si512((const void *)(in + i)), bit0);
+		_mm512_storeu_si512((void *)(out + i), _mm512_mask_blend_epi8(m, plus, minus));
+	}
+
+	gn3s_unpack8_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack16_avx512bw(const unsigned char *in, int16_t *out, int nbytes)
+{
+	const __m512i bit0 = _mm512_set1_epi8(1);
+	const __m512i plus = _mm512_set1_epi16(1);
+	const __m512i minus = _mm512_set1_epi16(-1);
+	uint64_t m;
+	int i;
+
+	for (i = 0; i + 64 <= nbytes; i += 64)
+	{
+		m = _mm512_test_epi8_mask(_mm512_loadu_si512((const void *)(in + i)), bit0);
+		_mm512_storeu_si512((void *)(out + i),
+				_mm512_mask_blend_epi16((__mmask32)(m), plus, minus));
+		_mm512_storeu_si512((void *)(out + i + 32),
+				_mm512_mask_blend_epi16((__mmask32)(m >> 32), plus, minus));
+	}
+
+	gn3s_unpack16_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! The vptestmb mask of 64 sign bits is the packed output itself
+void gn3s_pack_avx512bw(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	const __m512i bit0 = _mm512_set1_epi8(1);
+	uint64_t m;
+	int i;
+
+	for (i = 0; i + 64 <= nbytes; i += 64)
+	{
+		m = _mm512_test_epi8_mask(_mm512_loadu_si512((const void *)(in + i)), bit0);
+		memcpy(out + i / 8, &m, sizeof(m));
+	}
+
+	gn3s_pack_generic(in + i, out + i / 8, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
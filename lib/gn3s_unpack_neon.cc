@@ -0,0 +1,148 @@
+/*!
+ * \file gn3s_unpack_neon.cc
+ * \brief NEON unpack kernel for ARM.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_unpack.h"
+#include <arm_neon.h>
+
+/*----------------------------------------------------------------------------------------------*/
+//! Same trick as on x86: widen, shift bit 0 up to the sign bit, OR in 1.0f
+void gn3s_unpack_neon(const unsigned char *in, float *out, int nbytes)
+{
+	const uint32x4_t one = vdupq_n_u32(0x3f800000);
+	uint8x16_t v;
+	uint16x8_t lo, hi;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = vld1q_u8(in + i);
+		lo = vmovl_u8(vget_low_u8(v));
+		hi = vmovl_u8(vget_high_u8(v));
+		vst1q_f32(out + i, vreinterpretq_f32_u32(
+				vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(lo)), 31), one)));
+		vst1q_f32(out + i + 4, vreinterpretq_f32_u32(
+				vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(lo)), 31), one)));
+		vst1q_f32(out + i + 8, vreinterpretq_f32_u32(
+				vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(hi)), 31), one)));
+		vst1q_f32(out + i + 12, vreinterpretq_f32_u32(
+				vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(hi)), 31), one)));
+	}
+
+	gn3s_unpack_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! 16 bytes compared at once; the scalar check finds where a bad block goes wrong
+int gn3s_check_neon(const unsigned char *in, int nbytes)
+{
+	const uint8x16_t marker = vdupq_n_u8(GN3S_I_MARKER);
+	const uint8x16_t iq = vreinterpretq_u8_u16(vdupq_n_u16(GN3S_I_MARKER));
+	uint8x16_t eq;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		eq = vceqq_u8(vandq_u8(vld1q_u8(in + i), marker), iq);
+		if (vminvq_u8(eq) != 0xff)
+			return i + gn3s_check_generic(in + i, 16);
+	}
+
+	return i + gn3s_check_generic(in + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! 0 - (b & 1) is 0 or -1; OR-ing in 1 makes that +1 or -1
+void gn3s_unpack8_neon(const unsigned char *in, int8_t *out, int nbytes)
+{
+	const int8x16_t one = vdupq_n_s8(1);
+	int8x16_t v;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = vandq_s8(vreinterpretq_s8_u8(vld1q_u8(in + i)), one);
+		vst1q_s8(out + i, vorrq_s8(vnegq_s8(v), one));
+	}
+
+	gn3s_unpack8_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+void gn3s_unpack16_neon(const unsigned char *in, int16_t *out, int nbytes)
+{
+	const int8x16_t one8 = vdupq_n_s8(1);
+	const int16x8_t one = vdupq_n_s16(1);
+	int8x16_t v;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = vnegq_s8(vandq_s8(vreinterpretq_s8_u8(vld1q_u8(in + i)), one8));
+		vst1q_s16(out + i, vorrq_s16(vmovl_s8(vget_low_s8(v)), one));
+		vst1q_s16(out + i + 8, vorrq_s16(vmovl_s8(vget_high_s8(v)), one));
+	}
+
+	gn3s_unpack16_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * NEON has no movemask: the sign bits are shifted to their place in the
+ * output byte and each group of 8 summed with three pairwise adds.
+ */
+void gn3s_pack_neon(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	static const int8_t shift[16] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7};
+	const int8x16_t sh = vld1q_s8(shift);
+	const uint8x16_t one = vdupq_n_u8(1);
+	uint8x16_t v;
+	uint8x8_t s;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = vshlq_u8(vandq_u8(vld1q_u8(in + i), one), sh);
+		s = vpadd_u8(vget_low_u8(v), vget_high_u8(v));
+		s = vpadd_u8(s, s);
+		s = vpadd_u8(s, s);
+		out[i / 8] = vget_lane_u8(s, 0);
+		out[i / 8 + 1] = vget_lane_u8(s, 1);
+	}
+
+	gn3s_pack_generic(in + i, out + i / 8, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
@@ -0,0 +1,150 @@
+/*!
+ * \file gn3s_unpack_sse2.cc
+ * \brief SSE2 unpack kernel, built with -msse2.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "gn3s_unpack.h"
+#include <emmintrin.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Bytes are zero extended to 32 bits and shifted left by 31, which leaves
+ * just the sign bit; OR-ing in 1.0f then gives +1.0f or -1.0f.
+ */
+void gn3s_unpack_sse2(const unsigned char *in, float *out, int nbytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(0x3f800000);
+	__m128i v, lo, hi;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *)(in + i));
+		lo = _mm_unpacklo_epi8(v, zero);
+		hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128((__m128i *)(out + i),
+				_mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(lo, zero), 31), one));
+		_mm_storeu_si128((__m128i *)(out + i + 4),
+				_mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(lo, zero), 31), one));
+		_mm_storeu_si128((__m128i *)(out + i + 8),
+				_mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(hi, zero), 31), one));
+		_mm_storeu_si128((__m128i *)(out + i + 12),
+				_mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(hi, zero), 31), one));
+	}
+
+	gn3s_unpack_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! Marker bits of 16 bytes compared against I, Q, I, Q... in one go
+int gn3s_check_sse2(const unsigned char *in, int nbytes)
+{
+	const __m128i marker = _mm_set1_epi8(GN3S_I_MARKER);
+	const __m128i iq = _mm_set1_epi16(GN3S_I_MARKER);
+	__m128i v;
+	unsigned int m;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + i)), marker);
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, iq));
+		if (m != 0xffff)
+			return i + (__builtin_ctz(~m) & ~1);
+	}
+
+	return i + gn3s_check_generic(in + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! 0 - (b & 1) is 0 or -1; OR-ing in 1 makes that +1 or -1
+void gn3s_unpack8_sse2(const unsigned char *in, int8_t *out, int nbytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i v;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + i)), one);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(_mm_sub_epi8(zero, v), one));
+	}
+
+	gn3s_unpack8_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+//! As gn3s_unpack8_sse2, with the 0/-1 bytes doubled up into 16-bit lanes
+void gn3s_unpack16_sse2(const unsigned char *in, int16_t *out, int nbytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one8 = _mm_set1_epi8(1);
+	const __m128i one = _mm_set1_epi16(1);
+	__m128i v;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		v = _mm_sub_epi8(zero, _mm_and_si128(_mm_loadu_si128((const __m128i *)(in + i)), one8));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(_mm_unpacklo_epi8(v, v), one));
+		_mm_storeu_si128((__m128i *)(out + i + 8), _mm_or_si128(_mm_unpackhi_epi8(v, v), one));
+	}
+
+	gn3s_unpack16_generic(in + i, out + i, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
+
+
+/*----------------------------------------------------------------------------------------------*/
+/*!
+ * Shifting each 16-bit lane left by 7 moves the sign bit of both its
+ * bytes to their top bit, which pmovmskb gathers: 16 bytes give 16 bits,
+ * already in the I, Q, I, Q order of the packed output.
+ */
+void gn3s_pack_sse2(const unsigned char *in, uint8_t *out, int nbytes)
+{
+	uint16_t m;
+	int i;
+
+	for (i = 0; i + 16 <= nbytes; i += 16)
+	{
+		m = _mm_movemask_epi8(_mm_slli_epi16(_mm_loadu_si128((const __m128i *)(in + i)), 7));
+		memcpy(out + i / 8, &m, sizeof(m));
+	}
+
+	gn3s_pack_generic(in + i, out + i / 8, nbytes - i);
+}
+/*----------------------------------------------------------------------------------------------*/
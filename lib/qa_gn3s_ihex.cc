@@ -0,0 +1,89 @@
+/*!
+ * \file qa_gn3s_ihex.cc
+ * \brief Unit tests for the Intel HEX parser and loader and the firmware hash.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#include <boost/test/unit_test.hpp>
+#include <gn3s_ihex.h>
+#include <string.h>
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ihex_merge){
+    gn3s_fw_image image;
+    std::string error;
+
+    /* Two adjacent records out of order and a separate one */
+    const std::string text =
+        ":02000300AABB96\r\n"
+        ":03000000010203F7\n"
+        ":01E600000118\n"
+        ":00000001FF\n";
+
+    BOOST_REQUIRE(gn3s_ihex_parse(text, image, error));
+    BOOST_REQUIRE_EQUAL(image.size(), 2u);
+    BOOST_CHECK_EQUAL(image[0].addr, 0u);
+    BOOST_REQUIRE_EQUAL(image[0].data.size(), 5u);
+    BOOST_CHECK_EQUAL(image[0].data[2], 0x03);
+    BOOST_CHECK_EQUAL(image[0].data[3], 0xAA);
+    BOOST_CHECK_EQUAL(image[1].addr, 0xE600u);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ihex_errors){
+    gn3s_fw_image image;
+    std::string error;
+
+    /* Bad checksum */
+    BOOST_CHECK(!gn3s_ihex_parse(":03000000010203F8\n:00000001FF\n", image, error));
+    /* Length does not match the payload */
+    BOOST_CHECK(!gn3s_ihex_parse(":04000000010203F6\n:00000001FF\n", image, error));
+    /* No end of file record */
+    BOOST_CHECK(!gn3s_ihex_parse(":03000000010203F7\n", image, error));
+    /* Overlapping records */
+    BOOST_CHECK(!gn3s_ihex_parse(":03000000010203F7\n:0100020004F9\n:00000001FF\n", image, error));
+    /* Not a record */
+    BOOST_CHECK(!gn3s_ihex_parse("0300000001020F7\n:00000001FF\n", image, error));
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ihex_hash){
+    gn3s_fw_image image(1);
+    unsigned char a[GN3S_FW_HASH_SIZE], b[GN3S_FW_HASH_SIZE];
+
+    image[0].addr = 0x0100;
+    image[0].data.assign(64, 0x5a);
+    gn3s_fw_hash(image, a);
+    gn3s_fw_hash(image, b);
+    BOOST_CHECK(memcmp(a, b, sizeof(a)) == 0);
+
+    /* One byte changed */
+    image[0].data[17] ^= 1;
+    gn3s_fw_hash(image, b);
+    BOOST_CHECK(memcmp(a, b, sizeof(a)) != 0);
+
+    /* Same bytes loaded somewhere else */
+    image[0].data[17] ^= 1;
+    image[0].addr = 0x0200;
+    gn3s_fw_hash(image, b);
+    BOOST_CHECK(memcmp(a, b, sizeof(a)) != 0);
+}
@@ -0,0 +1,165 @@
+/*!
+ * \file qa_gn3s_ring.cc
+ * \brief Unit tests for the single producer / single consumer sample ring.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#include <boost/test/unit_test.hpp>
+#include <gn3s_ring.h>
+#include <string.h>
+#include <thread>
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ring_short_slots){
+    gn3s_ring ring(4, 8);
+    const unsigned char *p = nullptr;
+    int a, b;
+
+    a = ring.claim();
+    b = ring.claim();
+    memset(ring.slot(a), 1, 8);
+    memset(ring.slot(b), 2, 3);
+
+    /* Out of order commits are published in claim order */
+    ring.commit(b, 3);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 0);
+    ring.commit(a, 8);
+    BOOST_CHECK_EQUAL(ring.fill(), 11u);
+
+    /* A full slot runs into its successor */
+    BOOST_CHECK_EQUAL(ring.peek(&p), 11);
+    BOOST_CHECK_EQUAL(p[7], 1);
+    BOOST_CHECK_EQUAL(p[8], 2);
+    ring.consume(10);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 1);
+    ring.consume(1);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 0);
+    BOOST_CHECK_EQUAL(ring.fill(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ring_overrun){
+    gn3s_ring ring(2, 4);
+    const unsigned char *p = nullptr;
+
+    ring.commit(ring.claim(), 4);
+    ring.commit(ring.claim(), 4);
+    BOOST_CHECK_EQUAL(ring.claim(), -1);
+    ring.drop(4);
+    BOOST_CHECK_EQUAL(ring.get_overruns(), 1u);
+    BOOST_CHECK_EQUAL(ring.get_overrun_bytes(), 4u);
+
+    /* Slot 0 is only reusable once fully consumed */
+    BOOST_CHECK_EQUAL(ring.peek(&p), 8);
+    ring.consume(3);
+    BOOST_CHECK_EQUAL(ring.claim(), -1);
+    ring.consume(1);
+    BOOST_CHECK_EQUAL(ring.claim(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ring_gap){
+    gn3s_ring ring(4, 4);
+    const unsigned char *p = nullptr;
+    int a, b;
+
+    /* A transfer dropped between two slots, then an empty one */
+    ring.commit(ring.claim(), 4);
+    ring.drop(4);
+    ring.skip(2);
+    a = ring.claim();
+    b = ring.claim();
+    ring.commit(a, 0);
+    ring.commit(b, 4);
+    BOOST_CHECK_EQUAL(ring.get_lost_bytes(), 6u);
+
+    /* The run stops short of the gap, which is reported before the next byte */
+    BOOST_CHECK_EQUAL(ring.gap(), 0u);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 4);
+    ring.consume(4);
+    BOOST_CHECK_EQUAL(ring.gap(), 6u);
+    ring.take_gap();
+    BOOST_CHECK_EQUAL(ring.gap(), 0u);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 4);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ring_overrun_no_gap){
+    gn3s_ring ring(4, 4);
+    const unsigned char *p = nullptr;
+
+    /* An overrun with nothing estimated lost leaves the stream whole, but is counted */
+    ring.commit(ring.claim(), 4);
+    BOOST_CHECK(!ring.overrun(0));
+    ring.commit(ring.claim(), 4);
+    BOOST_CHECK_EQUAL(ring.get_ungapped_overruns(), 1u);
+    BOOST_CHECK_EQUAL(ring.get_lost_bytes(), 0u);
+    BOOST_CHECK_EQUAL(ring.peek(&p), 8);
+    ring.consume(8);
+    BOOST_CHECK_EQUAL(ring.gap(), 0u);
+
+    /* One with a loss shows as a gap instead */
+    BOOST_CHECK(ring.overrun(6));
+    ring.commit(ring.claim(), 4);
+    BOOST_CHECK_EQUAL(ring.get_ungapped_overruns(), 1u);
+    BOOST_CHECK_EQUAL(ring.gap(), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_ring_threads){
+    const int slots = 8, size = 64, total = 20000;
+    gn3s_ring ring(slots, size);
+    unsigned char expect = 0;
+    bool ok = true;
+    int got = 0;
+
+    std::thread producer([&]() {
+        unsigned char v = 0;
+        int idx, len;
+        for (int i = 0; i < total; )
+        {
+            idx = ring.claim();
+            if (idx < 0)
+                continue;
+            len = 1 + (i % size);
+            for (int j = 0; j < len; j++)
+                ring.slot(idx)[j] = v++;
+            ring.commit(idx, len);
+            i++;
+        }
+    });
+
+    const unsigned char *p = nullptr;
+    int n, expected_bytes = 0;
+    for (int i = 0; i < total; i++)
+        expected_bytes += 1 + (i % size);
+    while (got < expected_bytes)
+    {
+        n = ring.peek(&p);
+        for (int j = 0; j < n; j++)
+            ok &= (p[j] == expect++);
+        ring.consume(n);
+        got += n;
+    }
+    producer.join();
+
+    BOOST_CHECK(ok);
+    BOOST_CHECK_EQUAL(ring.get_overruns(), 0u);
+}
@@ -0,0 +1,258 @@
+/*!
+ * \file qa_gn3s_unpack.cc
+ * \brief Unit tests for the sample unpack, pack and check kernels and the I/Q tracker.
+ *
+ * -------------------------------------------------------------------------
+ *
+ * Copyright (C) 2010-2015  (see AUTHORS file for a list of contributors)
+ *
+ * GNSS-SDR is a software defined Global Navigation
+ *          Satellite Systems receiver
+ *
+ * This file is part of GNSS-SDR.
+ *
+ * GNSS-SDR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * at your option) any later version.
+ *
+ * GNSS-SDR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNSS-SDR. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * -------------------------------------------------------------------------
+ */
+#include <boost/test/unit_test.hpp>
+#include <gn3s_unpack.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_generic){
+    const unsigned char in[4] = {0x02, 0x01, 0x03, 0xfc};
+    float out[4];
+
+    gn3s_unpack_generic(in, out, 4);
+    BOOST_CHECK_EQUAL(out[0], 1.0f);
+    BOOST_CHECK_EQUAL(out[1], -1.0f);
+    BOOST_CHECK_EQUAL(out[2], -1.0f);
+    BOOST_CHECK_EQUAL(out[3], 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_kernels){
+    std::vector<gn3s_unpack_kernel> kernels = gn3s_unpack_kernels();
+    std::vector<unsigned char> in(1000 + 3);
+    std::vector<float> ref(in.size()), out(in.size() + 2);
+
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = rand() & 0xff;
+
+    /* Every length and misalignment must match the portable kernel, and write nothing past the end */
+    for (unsigned int k = 0; k < kernels.size(); k++)
+    {
+        BOOST_TEST_MESSAGE("kernel " << kernels[k].name);
+        for (int offset = 0; offset < 4; offset++)
+        {
+            for (int n = 0; n + offset <= 1000; n += 37)
+            {
+                gn3s_unpack_generic(&in[offset], &ref[0], n);
+                out[1 + n] = 42.0f;
+                kernels[k].fn(&in[offset], &out[1], n);
+                for (int i = 0; i < n; i++)
+                    BOOST_REQUIRE_EQUAL(out[1 + i], ref[i]);
+                BOOST_REQUIRE_EQUAL(out[1 + n], 42.0f);
+            }
+        }
+    }
+
+    BOOST_CHECK(gn3s_unpack_best().fn == kernels.back().fn);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_integer){
+    std::vector<gn3s_unpack_kernel> kernels = gn3s_unpack_kernels();
+    std::vector<unsigned char> in(1000);
+    std::vector<float> ref(in.size());
+    std::vector<int16_t> out16(in.size());
+    std::vector<int8_t> out8(in.size());
+
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = rand() & 0xff;
+
+    /* The integer outputs hold the same +1/-1 as the floats */
+    for (unsigned int k = 0; k < kernels.size(); k++)
+    {
+        BOOST_TEST_MESSAGE("kernel " << kernels[k].name);
+        for (int n = 0; n <= 1000; n += 41)
+        {
+            gn3s_unpack_generic(&in[0], &ref[0], n);
+            kernels[k].fn16(&in[0], &out16[0], n);
+            kernels[k].fn8(&in[0], &out8[0], n);
+            for (int i = 0; i < n; i++)
+            {
+                BOOST_REQUIRE_EQUAL(out16[i], (int)ref[i]);
+                BOOST_REQUIRE_EQUAL(out8[i], (int)ref[i]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_check){
+    std::vector<gn3s_unpack_kernel> kernels = gn3s_unpack_kernels();
+    std::vector<unsigned char> in(600);
+
+    /* A clean I, Q stream with one byte out of step at each position in turn */
+    for (int bad = 0; bad <= (int)in.size(); bad += 7)
+    {
+        for (unsigned int i = 0; i < in.size(); i++)
+            in[i] = (rand() & 0xfd) | ((i % 2) ? 0 : GN3S_I_MARKER);
+        if (bad < (int)in.size())
+            in[bad] ^= GN3S_I_MARKER;
+
+        for (unsigned int k = 0; k < kernels.size(); k++)
+            BOOST_REQUIRE_EQUAL(kernels[k].check(&in[0], in.size()),
+                    (bad < (int)in.size()) ? (bad & ~1) : (int)in.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_tracker){
+    std::vector<unsigned char> in(5000);
+    std::vector<float> ref(in.size()), out(in.size());
+    gn3s_iq_tracker whole, pieces;
+    int used, n, total, pos;
+
+    /* Starts on a Q byte, and one I byte goes missing half way */
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = (rand() & 0xfd) | ((i % 2) ? GN3S_I_MARKER : 0);
+    in.erase(in.begin() + 2001);
+
+    used = whole.unpack(&in[0], in.size(), &ref[0], GN3S_FLOAT, in.size(), &total);
+    BOOST_CHECK_EQUAL(used, (int)in.size());
+    BOOST_CHECK_EQUAL(whole.get_slips(), 1u);
+
+    /* Odd sized pieces and small output requests give the same samples */
+    n = 0;
+    for (pos = 0; pos < (int)in.size(); )
+    {
+        int len = std::min(1 + rand() % 77, (int)in.size() - pos);
+        int got;
+        used = pieces.unpack(&in[pos], len, &out[2 * n], GN3S_FLOAT, 1 + rand() % 20, &got);
+        pos += used;
+        n += got;
+    }
+    BOOST_CHECK_EQUAL(n, total);
+    BOOST_CHECK_EQUAL(pieces.get_slips(), 1u);
+    for (int i = 0; i < 2 * total; i++)
+        BOOST_REQUIRE_EQUAL(out[i], ref[i]);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_pack){
+    std::vector<gn3s_unpack_kernel> kernels = gn3s_unpack_kernels();
+    std::vector<unsigned char> in(1000 + 3);
+    std::vector<float> ref(in.size());
+    std::vector<uint8_t> out(in.size() / 8 + 2);
+
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = rand() & 0xff;
+
+    /* Bit i of the output is sample i, set where the float is -1; whole
+       I/Q pairs that do not fill the last byte leave its top bits clear */
+    for (unsigned int k = 0; k < kernels.size(); k++)
+    {
+        BOOST_TEST_MESSAGE("kernel " << kernels[k].name);
+        for (int offset = 0; offset < 4; offset++)
+        {
+            for (int n = 0; n + offset <= 1000; n += 26)
+            {
+                gn3s_unpack_generic(&in[offset], &ref[0], n);
+                out[(n + 7) / 8] = 0xff;
+                if (n % 8)
+                    out[(n - 1) / 8] = 0xff;
+                kernels[k].pack(&in[offset], &out[0], n);
+                for (int i = 0; i < n; i++)
+                    BOOST_REQUIRE_EQUAL((out[i / 8] >> (i % 8)) & 1, ref[i] < 0.0f);
+                if (n % 8)
+                    BOOST_REQUIRE_EQUAL(out[(n - 1) / 8] >> (n % 8), 0);
+                BOOST_REQUIRE_EQUAL(out[(n + 7) / 8], 0xff);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_tracker_packed){
+    std::vector<unsigned char> in(5000);
+    std::vector<float> ref(in.size());
+    std::vector<uint8_t> out(in.size() / 8 + 1);
+    gn3s_iq_tracker whole, pieces;
+    int used, n, total, pos;
+
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = (rand() & 0xfd) | ((i % 2) ? GN3S_I_MARKER : 0);
+    in.erase(in.begin() + 2001);
+
+    whole.unpack(&in[0], in.size(), &ref[0], GN3S_FLOAT, in.size(), &total);
+
+    /* Whole bytes only, and the pairs held back come out with the next piece */
+    n = 0;
+    for (pos = 0; pos < (int)in.size(); )
+    {
+        int len = std::min(1 + rand() % 77, (int)in.size() - pos);
+        int got;
+        used = pieces.unpack(&in[pos], len, &out[n / 4], GN3S_PACKED, 1 + rand() % 20, &got);
+        BOOST_REQUIRE_EQUAL(got % 4, 0);
+        pos += used;
+        n += got;
+    }
+    BOOST_CHECK_EQUAL(n, total & ~3);
+    BOOST_CHECK_EQUAL(pieces.get_slips(), 1u);
+    for (int i = 0; i < 2 * n; i++)
+        BOOST_REQUIRE_EQUAL((out[i / 8] >> (i % 8)) & 1, ref[i] < 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_phase){
+    static const gn3s_pack_fn phase[4] = { gn3s_pack_ref<0>, gn3s_pack_ref<1>,
+        gn3s_pack_ref<2>, gn3s_pack_ref<3> };
+    std::vector<unsigned char> in(200);
+    std::vector<uint8_t> out(in.size() / 8 + 2);
+    std::vector<int16_t> out16(in.size());
+
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = rand() & 0xff;
+
+    /* The integer references agree with each other */
+    gn3s_unpack_ref(&in[0], &out16[0], in.size());
+    for (unsigned int i = 0; i < in.size(); i++)
+        BOOST_REQUIRE_EQUAL(out16[i], (in[i] & 1) ? -1 : 1);
+
+    /* Earlier pairs in the first byte are kept, the stream follows them bit by bit */
+    for (int p = 0; p < 4; p++)
+    {
+        for (int n = 0; n <= (int)in.size(); n += 2)
+        {
+            uint8_t first = rand() & 0xff;
+            out[0] = first;
+            phase[p](&in[0], &out[0], n);
+            BOOST_REQUIRE_EQUAL(out[0] & ((1 << (2 * p)) - 1), first & ((1 << (2 * p)) - 1));
+            for (int i = 0; i < n; i++)
+                BOOST_REQUIRE_EQUAL((out[(2 * p + i) / 8] >> ((2 * p + i) % 8)) & 1, in[i] & 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(qa_gn3s_unpack_raw){
+    std::vector<unsigned char> in(3000), out(in.size());
+    gn3s_iq_tracker iq;
+    int used, n;
+
+    /* Raw output is the input, less a leading Q byte */
+    for (unsigned int i = 0; i < in.size(); i++)
+        in[i] = (rand() & 0xfd) | ((i % 2) ? GN3S_I_MARKER : 0);
+
+    used = iq.unpack(&in[0], in.size(), &out[0], GN3S_RAW, in.size(), &n);
+    BOOST_CHECK_EQUAL(used, (int)in.size());
+    BOOST_CHECK_EQUAL(n, (int)in.size() / 2 - 1);
+    BOOST_CHECK(std::equal(out.begin(), out.begin() + 2 * n, in.begin() + 1));
+}
@@ -9,9 +9,32 @@
 
 
 %{
+#include "gn3s_source_base.h"
 #include "gn3s_source_cc.h"
+#include "gn3s_source_cs.h"
+#include "gn3s_source_cb.h"
+#include "gn3s_source_ibyte.h"
+#include "gn3s_source_packed.h"
+#include "gn3s_source_raw.h"
 %}
 
+%include "gn3s_source_base.h"
+
 GR_SWIG_BLOCK_MAGIC(gn3s,source_cc);
 %include "gn3s_source_cc.h"
 
+GR_SWIG_BLOCK_MAGIC(gn3s,source_cs);
+%include "gn3s_source_cs.h"
+
+GR_SWIG_BLOCK_MAGIC(gn3s,source_cb);
+%include "gn3s_source_cb.h"
+
+GR_SWIG_BLOCK_MAGIC(gn3s,source_ibyte);
+%include "gn3s_source_ibyte.h"
+
+GR_SWIG_BLOCK_MAGIC(gn3s,source_packed);
+%include "gn3s_source_packed.h"
+
+GR_SWIG_BLOCK_MAGIC(gn3s,source_raw);
+%include "gn3s_source_raw.h"
+